@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+/**
+ * A std::allocator replacement that aligns every allocation to Align bytes,
+ * so that arrays can be loaded with aligned SIMD instructions.
+ */
+template <typename T, size_t Align>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Align> other;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align))); }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Align)); }
+
+    bool operator==(const AlignedAllocator&) const { return true; }
+    bool operator!=(const AlignedAllocator&) const { return false; }
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <limits>
+
+#include "linalg.hpp"
+#include "vertexarray.hpp"
+
+#define FLOAT_INF std::numeric_limits<float>::infinity()
+
+/**
+ * An axis-aligned bounding box. A default constructed box is empty.
+ */
+struct BoundingBox {
+    Vector<float, 3> min = {FLOAT_INF, FLOAT_INF, FLOAT_INF};
+    Vector<float, 3> max = {-FLOAT_INF, -FLOAT_INF, -FLOAT_INF};
+
+    bool empty() const { return min[0] > max[0]; }
+    Vector<float, 3> center() const { return (min + max) * 0.5f; }
+
+    void expand(const Vector<float, 3>& point) {
+        for (size_t i = 0; i < 3; i++) {
+            min[i] = std::min(min[i], point[i]);
+            max[i] = std::max(max[i], point[i]);
+        }
+    }
+
+    void expand(const BoundingBox& other) {
+        expand(other.min);
+        expand(other.max);
+    }
+};
+
+/**
+ * A bounding sphere. A negative radius marks an empty sphere.
+ */
+struct BoundingSphere {
+    Vector<float, 3> center;
+    float radius = -1;
+};
+
+/**
+ * The bounding box and bounding sphere of a set of points. The sphere is centered
+ * on the box, which is not minimal but is cheap and tight enough for culling.
+ */
+struct Bounds {
+    BoundingBox box;
+    BoundingSphere sphere;
+
+    /**
+     * Computes the bounds of the points in [first, points.size()).
+     * The first entry is skipped by default since objects keep a placeholder at index 0.
+     */
+    static Bounds fromPoints(const VertexArray<3>& points, size_t first = 1) {
+        Bounds bounds;
+        for (size_t i = first; i < points.size(); i++) bounds.box.expand(points[i]);
+        if (bounds.box.empty()) return bounds;
+
+        bounds.sphere.center = bounds.box.center();
+        bounds.sphere.radius = 0;
+        for (size_t i = first; i < points.size(); i++) {
+            bounds.sphere.radius = std::max(bounds.sphere.radius, (points[i] - bounds.sphere.center).norm());
+        }
+        return bounds;
+    }
+
+    /**
+     * Grows these bounds to also enclose other.
+     */
+    void merge(const Bounds& other) {
+        if (other.box.empty()) return;
+        if (box.empty()) {
+            *this = other;
+            return;
+        }
+
+        box.expand(other.box);
+        Vector<float, 3> center = box.center();
+        sphere.radius = std::max((sphere.center - center).norm() + sphere.radius,
+                                 (other.sphere.center - center).norm() + other.sphere.radius);
+        sphere.center = center;
+    }
+
+    void translate(const Vector<float, 3>& offset) {
+        if (box.empty()) return;
+        box.min = box.min + offset;
+        box.max = box.max + offset;
+        sphere.center = sphere.center + offset;
+    }
+};
+
+/**
+ * The six planes of a view frustum. The planes are extracted from a
+ * (model-)view-projection matrix, so they live in whatever space that matrix
+ * transforms from: world space for projection * view, or the model space of an
+ * object for projection * view * model.
+ */
+class Frustum {
+   private:
+    Vector<float, 4> planes[6];
+
+   public:
+    Frustum() = default;
+
+    /**
+     * Extracts the planes with the Gribb-Hartmann method. Each plane is stored as
+     * (normal, distance) with the normal pointing inwards and normalized, so that
+     * dot(normal, p) + distance is the signed distance of p to the plane.
+     */
+    Frustum(const Matrix<float, 4, 4>& m) {
+        planes[0] = m[3] + m[0];  // left
+        planes[1] = m[3] - m[0];  // right
+        planes[2] = m[3] + m[1];  // bottom
+        planes[3] = m[3] - m[1];  // top
+        planes[4] = m[3] + m[2];  // near
+        planes[5] = m[3] - m[2];  // far
+
+        for (auto& plane : planes) {
+            plane = plane / Vector<float, 3>(plane).norm();
+        }
+    }
+
+    bool intersects(const BoundingSphere& sphere) const {
+        if (sphere.radius < 0) return false;
+        for (const auto& plane : planes) {
+            if (Vector<float, 3>(plane).dot(sphere.center) + plane[3] < -sphere.radius) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Tests the corner of the box furthest along each plane's normal, so a box
+     * is only rejected if it lies entirely outside one of the planes.
+     */
+    bool intersects(const BoundingBox& box) const {
+        if (box.empty()) return false;
+        for (const auto& plane : planes) {
+            Vector<float, 3> corner;
+            for (size_t i = 0; i < 3; i++) corner[i] = plane[i] >= 0 ? box.max[i] : box.min[i];
+            if (Vector<float, 3>(plane).dot(corner) + plane[3] < 0) return false;
+        }
+        return true;
+    }
+
+    bool intersects(const Bounds& bounds) const {
+        return intersects(bounds.sphere) && intersects(bounds.box);
+    }
+};
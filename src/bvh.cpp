@@ -0,0 +1,284 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "object.hpp"
+#include "vertexcache.hpp"
+
+#define MAX_BVH_DEPTH 64
+
+/**
+ * Intersects a ray with a box using the slab method.
+ *
+ * A ray parallel to a pair of slab planes is handled on its own, since its origin
+ * can lie exactly on one of them, where the slab distance would be 0 * inf = NaN.
+ *
+ * @param box The box to intersect.
+ * @param ray The ray to intersect the box with.
+ * @param invDirection The componentwise reciprocal of the ray's direction.
+ * @param tMax Hits further away than this are ignored.
+ * @param tNear Receives the distance at which the ray enters the box.
+ * @return Whether the ray enters the box before tMax.
+ */
+static bool intersectBox(const BoundingBox& box, const Ray& ray, const Vector<float, 3>& invDirection, float tMax,
+                         float& tNear) {
+    float t0 = 0, t1 = tMax;
+    for (size_t i = 0; i < 3; i++) {
+        if (ray.direction[i] == 0) {
+            if (ray.origin[i] < box.min[i] || ray.origin[i] > box.max[i]) return false;
+            continue;
+        }
+
+        float a = (box.min[i] - ray.origin[i]) * invDirection[i];
+        float b = (box.max[i] - ray.origin[i]) * invDirection[i];
+        if (a > b) std::swap(a, b);
+        t0 = std::max(t0, a);
+        t1 = std::min(t1, b);
+    }
+    tNear = t0;
+    return t0 <= t1;
+}
+
+/**
+ * Intersects a ray with a triangle using the Moller-Trumbore algorithm.
+ *
+ * @return Whether the ray hits the front or back of the triangle at a positive
+ * distance, in which case t, u and v receive the distance and barycentrics of the hit.
+ */
+static bool intersectTriangle(const Ray& ray, const Vector<float, 3> v[3], float& t, float& u, float& w) {
+    Vector<float, 3> edge1 = v[1] - v[0];
+    Vector<float, 3> edge2 = v[2] - v[0];
+    Vector<float, 3> p = ray.direction.cross(edge2);
+    float det = edge1.dot(p);
+    if (std::fabs(det) < 1e-12f) return false;
+
+    float invDet = 1 / det;
+    Vector<float, 3> s = ray.origin - v[0];
+    u = s.dot(p) * invDet;
+    if (u < 0 || u > 1) return false;
+
+    Vector<float, 3> q = s.cross(edge1);
+    w = ray.direction.dot(q) * invDet;
+    if (w < 0 || u + w > 1) return false;
+
+    t = edge2.dot(q) * invDet;
+    return t > 0;
+}
+
+/**
+ * @brief Builds the hierarchy over the triangles of an Object.
+ *
+ * Nodes spanning several material ranges are split at the range boundary closest
+ * to their middle. All other nodes are split at the median triangle centroid along
+ * the longest axis of their centroid bounds until they hold at most LEAF_SIZE
+ * triangles. The Object's index buffer is then reordered so that each leaf owns
+ * a contiguous range of triangles.
+ *
+ * @param object The Object to build the hierarchy for. Its model vertices must be final.
+ */
+void BVH::build(Object& object) {
+    nodes.clear();
+    const uint32_t count = object.triangleCount();
+    if (count == 0) return;
+
+    std::vector<uint32_t> order(count);
+    std::vector<Vector<float, 3>> centroids(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const uint32_t* corners = &object.indices[3 * i];
+        order[i] = i;
+        centroids[i] = (object.modelVertices[corners[0]] + object.modelVertices[corners[1]] +
+                        object.modelVertices[corners[2]]) / 3.0f;
+    }
+
+    nodes.reserve(2 * (count / LEAF_SIZE + object.materialRanges.size()));
+    build(object, order, centroids, 0, count);
+
+    std::vector<uint32_t> reordered(object.indices.size());
+    for (uint32_t i = 0; i < count; i++) std::copy_n(&object.indices[3 * order[i]], 3, &reordered[3 * i]);
+    object.indices = std::move(reordered);
+
+    updateLeafRanges(object);
+}
+
+/**
+ * @brief Optimizes the order of the Object's triangles and vertices for drawing.
+ *
+ * The triangles of each leaf are reordered for the vertex cache, then the
+ * Object's vertices are renumbered in the order the triangles use them. Leaves
+ * keep their triangles, so the hierarchy and the material ranges stay valid,
+ * while the vertex range of each leaf shrinks to little more than the vertices
+ * it actually uses. Leaves are usually transformed one range at a time, so this
+ * avoids transforming vertices of other leaves that happen to lie in between.
+ *
+ * @param object The Object the hierarchy was built for.
+ */
+void BVH::optimize(Object& object) {
+    for (const BVHNode& node : nodes) {
+        if (node.leaf()) optimizeVertexCache(&object.indices[3 * node.first], node.count);
+    }
+    optimizeVertexFetch(object);
+    updateLeafRanges(object);
+}
+
+/**
+ * Computes the range of vertex indices referenced by the triangles of each leaf.
+ */
+void BVH::updateLeafRanges(const Object& object) {
+    for (BVHNode& node : nodes) {
+        if (!node.leaf()) continue;
+
+        node.vertices = {UINT32_MAX, 0};
+        for (uint32_t i = 3 * node.first; i < 3 * (node.first + node.count); i++) {
+            node.vertices.first = std::min(node.vertices.first, object.indices[i]);
+            node.vertices.last = std::max(node.vertices.last, object.indices[i] + 1);
+        }
+    }
+}
+
+/**
+ * Builds the subtree over the triangles order[first, first + count).
+ *
+ * @return The index of the subtree's root node.
+ */
+uint32_t BVH::build(Object& object, std::vector<uint32_t>& order, const std::vector<Vector<float, 3>>& centroids,
+                    uint32_t first, uint32_t count) {
+    const uint32_t index = nodes.size();
+    nodes.emplace_back();
+
+    BoundingBox box, centroidBox;
+    for (uint32_t i = first; i < first + count; i++) {
+        for (size_t j = 0; j < 3; j++) box.expand(object.modelVertices[object.indices[3 * order[i] + j]]);
+        centroidBox.expand(centroids[order[i]]);
+    }
+    nodes[index].box = box;
+
+    // Material ranges starting inside this node are boundaries no leaf may cross
+    const int64_t middle = first + count / 2;
+    uint32_t split = 0;
+    for (const MaterialRange& range : object.materialRanges) {
+        if (range.first <= first || range.first >= first + count) continue;
+        if (split == 0 || std::abs(range.first - middle) < std::abs(split - middle)) split = range.first;
+    }
+
+    Vector<float, 3> extent = centroidBox.max - centroidBox.min;
+    size_t axis = extent[0] > extent[1] ? (extent[0] > extent[2] ? 0 : 2) : (extent[1] > extent[2] ? 1 : 2);
+
+    // Small enough, or every centroid is in the same place and splitting cannot separate them
+    if (split == 0 && (count <= LEAF_SIZE || extent[axis] <= 0)) {
+        BVHNode& leaf = nodes[index];
+        leaf.first = first;
+        leaf.count = count;
+        leaf.material = 0;
+        while (leaf.material + 1 < object.materialRanges.size() && object.materialRanges[leaf.material + 1].first <= first)
+            leaf.material++;
+        return index;
+    }
+
+    if (split == 0) {
+        split = first + count / 2;
+        std::nth_element(order.begin() + first, order.begin() + split, order.begin() + first + count,
+                         [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+    }
+
+    build(object, order, centroids, first, split - first);
+    uint32_t right = build(object, order, centroids, split, first + count - split);
+
+    nodes[index].first = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+/**
+ * @brief Collects the leaves whose bounds intersect the frustum.
+ *
+ * Subtrees are rejected as a whole as soon as their box lies outside one of
+ * the frustum planes, so the cost is proportional to the visible part of the
+ * Object rather than to its size.
+ *
+ * @param frustum The frustum, in the Object's model space.
+ * @param leaves Receives the visible leaves, in triangle order.
+ */
+void BVH::cull(const Frustum& frustum, std::vector<const BVHNode*>& leaves) const {
+    if (nodes.empty()) return;
+
+    uint32_t stack[MAX_BVH_DEPTH];
+    size_t size = 0;
+    stack[size++] = 0;
+
+    while (size > 0) {
+        const uint32_t index = stack[--size];
+        const BVHNode& node = nodes[index];
+        if (!frustum.intersects(node.box)) continue;
+
+        if (node.leaf()) {
+            leaves.push_back(&node);
+            continue;
+        }
+
+        stack[size++] = node.first;
+        stack[size++] = index + 1;
+    }
+}
+
+/**
+ * @brief Finds the nearest triangle hit by a ray.
+ *
+ * Children are visited nearest first, and subtrees further away than the
+ * nearest hit found so far are skipped.
+ *
+ * @param ray The ray, in the Object's model space.
+ * @param object The Object the hierarchy was built for.
+ * @param hit The nearest hit so far. It is only updated if a nearer hit is found,
+ * so one RayHit can be passed to several queries to find the nearest hit among them.
+ * @return Whether a nearer hit was found.
+ */
+bool BVH::intersect(const Ray& ray, const Object& object, RayHit& hit) const {
+    if (nodes.empty()) return false;
+
+    const Vector<float, 3> invDirection = {1 / ray.direction[0], 1 / ray.direction[1], 1 / ray.direction[2]};
+    uint32_t stack[MAX_BVH_DEPTH];
+    size_t size = 0;
+    bool found = false;
+
+    float tNear;
+    if (!intersectBox(nodes[0].box, ray, invDirection, hit.t, tNear)) return false;
+    stack[size++] = 0;
+
+    while (size > 0) {
+        const uint32_t index = stack[--size];
+        const BVHNode& node = nodes[index];
+
+        if (node.leaf()) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                const uint32_t* corners = &object.indices[3 * i];
+                Vector<float, 3> v[3] = {object.modelVertices[corners[0]], object.modelVertices[corners[1]],
+                                         object.modelVertices[corners[2]]};
+                float t, u, w;
+                if (intersectTriangle(ray, v, t, u, w) && t < hit.t) {
+                    hit = RayHit{t, u, w, &object, i};
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        float tLeft, tRight;
+        bool left = intersectBox(nodes[index + 1].box, ray, invDirection, hit.t, tLeft);
+        bool right = intersectBox(nodes[node.first].box, ray, invDirection, hit.t, tRight);
+
+        // Push the further child first so the nearer one is visited next
+        if (left && right && tLeft < tRight) {
+            stack[size++] = node.first;
+            stack[size++] = index + 1;
+        } else if (left && right) {
+            stack[size++] = index + 1;
+            stack[size++] = node.first;
+        } else if (left) {
+            stack[size++] = index + 1;
+        } else if (right) {
+            stack[size++] = node.first;
+        }
+    }
+    return found;
+}
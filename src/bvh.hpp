@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "bounds.hpp"
+#include "linalg.hpp"
+#include "ray.hpp"
+
+struct Object;
+
+/**
+ * The nearest hit found by a ray query: the Object and the index of the triangle
+ * that was hit, and the instance of its Mesh it was hit on. u and v are the
+ * barycentric weights of the triangle's second and third vertex at the hit point.
+ */
+struct RayHit {
+    float t = FLOAT_INF;
+    float u = 0, v = 0;
+    const Object* object = nullptr;
+    uint32_t triangle = 0;
+    uint32_t instance = 0;
+};
+
+/**
+ * A half-open range [first, last) of vertex indices.
+ */
+struct IndexRange {
+    uint32_t first, last;
+};
+
+/**
+ * A node of a BVH. Inner nodes store their left child directly after themselves
+ * and the index of their right child in first. Leaves own the triangles
+ * [first, first + count) of their Object, which all lie in the material range
+ * with index material, and the range of vertex indices those triangles reference.
+ */
+struct BVHNode {
+    BoundingBox box;
+    uint32_t first;
+    uint32_t count;
+    uint32_t material;
+    IndexRange vertices;
+
+    bool leaf() const { return count > 0; }
+};
+
+/**
+ * A bounding volume hierarchy over the triangles of one Object, in its model space.
+ *
+ * Building the hierarchy reorders the Object's triangles so that every leaf covers
+ * a contiguous range of them. Triangles never move out of their material range,
+ * so the Object's material ranges stay valid and each leaf has a single material.
+ * Leaves are kept large enough to amortize the per-leaf work of drawing, so
+ * culling works on clusters of triangles rather than on single ones.
+ */
+class BVH {
+   private:
+    std::vector<BVHNode> nodes;
+
+    uint32_t build(Object& object, std::vector<uint32_t>& order, const std::vector<Vector<float, 3>>& centroids,
+                   uint32_t first, uint32_t count);
+    void updateLeafRanges(const Object& object);
+
+   public:
+    static constexpr uint32_t LEAF_SIZE = 64;
+
+    void build(Object& object);
+    void optimize(Object& object);
+    bool empty() const { return nodes.empty(); }
+
+    // The nodes in depth-first order, as stored in the mesh cache
+    const std::vector<BVHNode>& getNodes() const { return nodes; }
+    void setNodes(std::vector<BVHNode> nodes) { this->nodes = std::move(nodes); }
+
+    void cull(const Frustum& frustum, std::vector<const BVHNode*>& leaves) const;
+    bool intersect(const Ray& ray, const Object& object, RayHit& hit) const;
+};
@@ -4,6 +4,7 @@
 #include <math.h>
 
 #include "linalg.hpp"
+#include "ray.hpp"
 
 #define CLAMP(x, min, max) ((x) < (min) ? (min) : ((x) > (max) ? (max) : (x)))
 
@@ -14,15 +15,27 @@ class Camera {
     Vector<float, 3> position;
     Vector<float, 2> rotation;
     float ooTan, zNear, zFar;
+    // Changes whenever the view does, so that transforms derived from it can tell they are stale
+    uint64_t version = 0;
 
     public:
     Matrix<float, 4, 4> getView() { return this->view; }
+    uint64_t getVersion() { return this->version; }
     Matrix<float, 4, 4> getProjection() { return this->projection; }
     Matrix<float, 3, 3> getRotationMatrix() { return Matrix<float, 3, 3>(this->view).transpose(); }
 
     Vector<float, 3> getPosition() { return this->position; }
     Vector<float, 2> getRotation() { return this->rotation; }
 
+    /**
+     * Returns the world space ray from the camera through the given pixel, for picking.
+     */
+    Ray getRay(float x, float y, const Viewport& viewport) {
+        Vector<float, 3> direction = {(2 * x - viewport.width) / (viewport.scale * ooTan),
+                                      (viewport.height - 2 * y) / (viewport.scale * ooTan), -1};
+        return Ray{this->position, getRotationMatrix() * direction};
+    }
+
     Vector<float, 3> getUp() { return Vector<float, 3>({0, 1, 0}); }
     Vector<float, 3> getRight() { return getRotationMatrix() * Vector<float, 3>({1, 0, 0}); }
     Vector<float, 3> getForward() { return getRotationMatrix() * Vector<float, 3>({0, 0, -1}); }
@@ -38,6 +51,7 @@ class Camera {
     void setPosition(Vector<float, 3> position) {
         this->position = position;
         this->view.set_position(Matrix<float, 3, 3>(this->view) * this->position * -1);
+        this->version++;
     }
 
     Camera(float fovDeg, float zNear, float zFar) {
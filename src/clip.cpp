@@ -0,0 +1,60 @@
+#include "clip.hpp"
+
+#include <algorithm>
+
+/**
+ * Signed distance of a clip-space point to the near or far plane, positive on the inside.
+ */
+static float planeDistance(const Vector<float, 4>& position, uint8_t plane) {
+    return plane == CLIP_NEAR ? position[3] + position[2] : position[3] - position[2];
+}
+
+static ClipVertex lerp(const ClipVertex& a, const ClipVertex& b, float t) {
+    return ClipVertex{a.position + (b.position - a.position) * t,
+                      a.uv + (b.uv - a.uv) * t,
+                      a.normal + (b.normal - a.normal) * t,
+                      -1};
+}
+
+/**
+ * One Sutherland-Hodgman pass: keeps the part of a convex polygon on the inside of a plane.
+ * The output has at most one more vertex than the input.
+ */
+static size_t clipAgainst(const ClipVertex in[], size_t count, uint8_t plane, ClipVertex out[]) {
+    size_t clipped = 0;
+    for (size_t i = 0; i < count; i++) {
+        const ClipVertex& a = in[i];
+        const ClipVertex& b = in[(i + 1) % count];
+        float da = planeDistance(a.position, plane);
+        float db = planeDistance(b.position, plane);
+
+        if (da >= 0) out[clipped++] = a;
+        if ((da >= 0) != (db >= 0)) out[clipped++] = lerp(a, b, da / (da - db));
+    }
+    return clipped;
+}
+
+/**
+ * Clips a clip-space triangle against the near and/or far plane.
+ *
+ * Attributes are interpolated linearly in clip space, which keeps them perspective
+ * correct once the resulting polygon is projected. Vertices that were not moved by
+ * clipping are copied unchanged, including their index.
+ *
+ * @param triangle The three vertices of the triangle, in winding order.
+ * @param planes The ClipPlane bits to clip against (only CLIP_NEAR and CLIP_FAR are used).
+ * @param polygon Receives the vertices of the clipped convex polygon, in winding order.
+ * @return The number of vertices in the clipped polygon, 0 if nothing is left.
+ */
+size_t clipTriangle(const ClipVertex triangle[3], uint8_t planes, ClipVertex polygon[MAX_CLIP_VERTICES]) {
+    ClipVertex buffer[MAX_CLIP_VERTICES];
+    std::copy(triangle, triangle + 3, polygon);
+    size_t count = 3;
+
+    for (uint8_t plane : {CLIP_NEAR, CLIP_FAR}) {
+        if (!(planes & plane)) continue;
+        count = clipAgainst(polygon, count, plane, buffer);
+        std::copy(buffer, buffer + count, polygon);
+    }
+    return count;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "linalg.hpp"
+
+// A triangle clipped against the near and far planes has at most five vertices
+#define MAX_CLIP_VERTICES 5
+
+/**
+ * A polygon vertex in clip space together with the attributes interpolated along with it.
+ * index is the vertex's position in its object, or -1 if the vertex was created by clipping.
+ */
+struct ClipVertex {
+    Vector<float, 4> position;
+    Vector<float, 2> uv;
+    Vector<float, 3> normal;
+    int index;
+};
+
+size_t clipTriangle(const ClipVertex triangle[3], uint8_t planes, ClipVertex polygon[MAX_CLIP_VERTICES]);
@@ -510,6 +510,40 @@ class Matrix {
         return position;
     }
 
+    /**
+     * Computes the inverse of an affine transformation matrix.
+     *
+     * The upper 3x3 block is inverted through its adjugate and the translation
+     * is mapped back through that inverse. The last row is assumed to be
+     * (0, 0, 0, 1), as it is for every model and view matrix.
+     *
+     * @return The inverse of this matrix.
+     * @note This function is only implemented for 4x4 matrices.
+     */
+    Matrix inverse_affine() const {
+        static_assert(N == 4 && M == 4, "Affine inverse is only implemented for 4x4 matrices");
+        const auto& m = data;
+        Matrix result;
+        result[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+        result[0][1] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+        result[0][2] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+        result[1][0] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+        result[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+        result[1][2] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+        result[2][0] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+        result[2][1] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+        result[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+        T inv_det = 1 / (m[0][0] * result[0][0] + m[0][1] * result[1][0] + m[0][2] * result[2][0]);
+        for (size_t i = 0; i < 3; ++i) {
+            for (size_t j = 0; j < 3; ++j) result[i][j] *= inv_det;
+        }
+        for (size_t i = 0; i < 3; ++i) {
+            result[i][3] = -(result[i][0] * m[0][3] + result[i][1] * m[1][3] + result[i][2] * m[2][3]);
+        }
+        return result;
+    }
+
     /**
      * Sets the rotation of the matrix to the given Euler angles.
      *
@@ -588,3 +622,104 @@ class Matrix {
         data[2][2] = cp * cy;
     }
 };
+
+/**
+ * Describes how normalized device coordinates map to pixels: x and y in [-1, 1]
+ * are scaled by half of the larger window dimension around the window center,
+ * with y pointing down.
+ */
+struct Viewport {
+    float width, height, scale;
+};
+
+/**
+ * Outcode bits marking which frustum planes a clip-space point lies outside of.
+ */
+enum ClipPlane : uint8_t {
+    CLIP_LEFT = 1 << 0,
+    CLIP_RIGHT = 1 << 1,
+    CLIP_BOTTOM = 1 << 2,
+    CLIP_TOP = 1 << 3,
+    CLIP_NEAR = 1 << 4,
+    CLIP_FAR = 1 << 5
+};
+
+/**
+ * Transforms a batch of points into pixel coordinates in one fused pass.
+ *
+ * Each point is multiplied by the 4x4 matrix (with w taken to be 1), divided
+ * by its clip-space w and mapped to the viewport. The points are given as
+ * structure-of-arrays: in holds the x, y and z arrays and out receives the pixel
+ * x, pixel y and the clip-space w, which the rasterizer uses as depth. The
+ * clip-space outcode of every point is written to outcodes, so that triangles can
+ * be culled or clipped against the frustum without transforming them again.
+ * The loop is vectorized and split across threads for large batches.
+ *
+ * @param transform The model-view-projection matrix.
+ * @param in The x, y and z arrays of the input points.
+ * @param out The x, y and w arrays to write the transformed points to.
+ * @param outcodes The array to write the ClipPlane bits of each point to.
+ * @param count The number of points to transform.
+ * @param viewport The viewport to map the points to.
+ */
+template <typename T>
+void transformToViewport(const Matrix<T, 4, 4>& transform, const T* const in[3], T* const out[3], uint8_t* outcodes,
+                         size_t count, const Viewport& viewport) {
+    T m[4][4];
+    for (size_t r = 0; r < 4; r++)
+        for (size_t c = 0; c < 4; c++) m[r][c] = transform[r][c];
+
+    const T *x = in[0], *y = in[1], *z = in[2];
+    T *px = out[0], *py = out[1], *pw = out[2];
+    const T half_width = viewport.width / 2, half_height = viewport.height / 2, half_scale = viewport.scale / 2;
+
+    #pragma omp parallel for simd schedule(static) if (count >= 4096)
+    for (size_t i = 0; i < count; i++) {
+        T cx = m[0][0] * x[i] + m[0][1] * y[i] + m[0][2] * z[i] + m[0][3];
+        T cy = m[1][0] * x[i] + m[1][1] * y[i] + m[1][2] * z[i] + m[1][3];
+        T cz = m[2][0] * x[i] + m[2][1] * y[i] + m[2][2] * z[i] + m[2][3];
+        T cw = m[3][0] * x[i] + m[3][1] * y[i] + m[3][2] * z[i] + m[3][3];
+        T inv_w = 1 / cw;
+
+        px[i] = half_width + cx * inv_w * half_scale;
+        py[i] = half_height - cy * inv_w * half_scale;
+        pw[i] = cw;
+        outcodes[i] = (cx < -cw) * CLIP_LEFT | (cx > cw) * CLIP_RIGHT |
+                      (cy < -cw) * CLIP_BOTTOM | (cy > cw) * CLIP_TOP |
+                      (cz < -cw) * CLIP_NEAR | (cz > cw) * CLIP_FAR;
+    }
+}
+
+/**
+ * Rotates a batch of normals by the upper 3x3 block of a matrix and renormalizes
+ * them, in one vectorized pass over structure-of-arrays data. Translation is
+ * ignored, and zero-length normals stay zero.
+ *
+ * @param transform The matrix to rotate the normals by.
+ * @param in The x, y and z arrays of the input normals.
+ * @param out The x, y and z arrays to write the transformed normals to.
+ * @param count The number of normals to transform.
+ */
+template <typename T, size_t N>
+void transformNormals(const Matrix<T, N, N>& transform, const T* const in[3], T* const out[3], size_t count) {
+    static_assert(N >= 3, "Normal transform must be at least 3x3");
+    T m[3][3];
+    for (size_t r = 0; r < 3; r++)
+        for (size_t c = 0; c < 3; c++) m[r][c] = transform[r][c];
+
+    const T *x = in[0], *y = in[1], *z = in[2];
+    T *nx = out[0], *ny = out[1], *nz = out[2];
+
+    #pragma omp parallel for simd schedule(static) if (count >= 4096)
+    for (size_t i = 0; i < count; i++) {
+        T tx = m[0][0] * x[i] + m[0][1] * y[i] + m[0][2] * z[i];
+        T ty = m[1][0] * x[i] + m[1][1] * y[i] + m[1][2] * z[i];
+        T tz = m[2][0] * x[i] + m[2][1] * y[i] + m[2][2] * z[i];
+        T norm2 = tx * tx + ty * ty + tz * tz;
+        T inv_norm = norm2 > 0 ? 1 / sqrt(norm2) : 0;
+
+        nx[i] = tx * inv_norm;
+        ny[i] = ty * inv_norm;
+        nz[i] = tz * inv_norm;
+    }
+}
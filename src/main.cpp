@@ -1,11 +1,20 @@
 #include <SDL2/SDL.h>
 #include <stdlib.h>
 
+#include <charconv>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 #include "camera.hpp"
 #include "linalg.hpp"
 #include "mesh.hpp"
+#include "profiler.hpp"
+#include "rasterizer.hpp"
+#include "scenenode.hpp"
+#include "texture.hpp"
 #include "window.hpp"
 
 namespace State {
@@ -22,22 +31,71 @@ namespace Settings {
     float speed = baseSpeed;
 
     float sensitivity = 0.003f;
+
+    // Headless mode renders a fixed animation offscreen instead of opening a window
+    bool headless = false;
+    int frames = 120;
+    float frameTime = 1.0f / 30.0f;
+    std::string outputDir = "";
+    std::string outputFormat = "ppm";
+
+    // Benchmark mode renders a fixed scene and reports frame time statistics as JSON
+    bool benchmark = false;
+    int warmupFrames = 10;
+    std::string jsonPath = "";
+
+    FillMode fillMode = HALF_SPACE;
+    CullMode cullMode = CULL_BACK;
+    ShadingMode shadingMode = FORWARD;
+    TextureLayout textureLayout = TEXTURE_LINEAR;
+
+    // Side length of the field of grass blocks drawn below the scene, 0 for none
+    int fieldSize = 0;
+
+    // Reorder triangles and vertices for vertex locality when loading meshes
+    bool optimizeMeshes = true;
 }  // namespace Settings
 
 namespace Engine {
     namespace {
+        // The root of the scene graph, which every mesh is placed in
+        SceneNode scene;
         std::vector<std::unique_ptr<Mesh>> meshes;
 
         void loadMesh(std::string path, Vector<float, 3> position = {0, 0, 0}, Vector<float, 3> scale = {1, 1, 1}, Vector<float, 3> rotation = {0, 0, 0}) {
-            std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>(path);
+            std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>(path, Settings::optimizeMeshes);
             // mesh->printObjects();
             // mesh->printTriangles();
             // mesh->printMaterials();
+            mesh->setParent(&scene);
             mesh->setRotation(rotation);
             mesh->setPosition(position);
             mesh->setScale(scale);
             meshes.push_back(std::move(mesh));
         }
+
+        // Drawn as instances of one Mesh, and not rotated by update()
+        std::unique_ptr<Mesh> field;
+
+        /**
+         * Lays out a size x size grid of grass blocks below the scene, all sharing
+         * the geometry of one Mesh.
+         */
+        void loadField(int size) {
+            if (size <= 0) return;
+            field = std::make_unique<Mesh>("src/Assets/Grass_Block", Settings::optimizeMeshes);
+            field->setParent(&scene);
+
+            std::vector<Matrix<float, 4, 4>> instances;
+            for (int z = 0; z < size; z++) {
+                for (int x = 0; x < size; x++) {
+                    Matrix<float, 4, 4> instance;
+                    instance.set_position({2.0f * x - size + 1, -3.0f, 2.0f * z - size + 1 - 10.0f});
+                    instances.push_back(instance);
+                }
+            }
+            field->setInstances(std::move(instances));
+        }
     }  // namespace
 
     std::unique_ptr<Camera> camera;
@@ -46,17 +104,56 @@ namespace Engine {
         camera = std::make_unique<Camera>(60, 0.1f, 100.0f);
         loadMesh("src/Assets/Grass_Block", {0.0f, 0.0f, -10.0f});
         // loadMesh("src/Assets/Utah_Teapot", {0.0f, 0.0f, -10.0f}, {0.05f, 0.05f, 0.05f});
+        loadField(Settings::fieldSize);
     };
 
-    void update(float deltaTime) {
+    void setupBenchmark() {
+        camera = std::make_unique<Camera>(60, 0.1f, 100.0f);
+        loadMesh("src/Assets/Grass_Block", {-2.5f, 0.0f, -10.0f});
+        loadMesh("src/Assets/Utah_Teapot", {2.5f, 0.0f, -10.0f}, {0.05f, 0.05f, 0.05f});
+        loadField(Settings::fieldSize);
+    };
+
+    void draw() {
+        if (field) field->draw(camera.get(), false);
         for (auto& mesh : meshes) {
             mesh->draw(camera.get(), false);
+        }
+
+        // The triangles of every mesh are filled together, so deferred shading shades each pixel once per frame
+        Rasterizer& rasterizer = Rasterizer::getInstance();
+        Profiler& profiler = Profiler::getInstance();
+        uint64_t startTime = profiler.now();
+        rasterizer.flush();
+        profiler.record(RASTERIZATION, startTime);
+
+        startTime = profiler.now();
+        rasterizer.resolve();
+        profiler.record(SHADING, startTime);
+    };
+
+    void update(float deltaTime) {
+        draw();
+        for (auto& mesh : meshes) {
             mesh->setRotation((mesh->getRotation() + Vector<float, 3>({0.6f, 0.6f, 0.6f}) * deltaTime) % (2 * M_PI));
         }
     };
 
+    /**
+     * Moves the camera along a scripted orbit around the origin of the scene,
+     * so headless runs render the same frames on every machine.
+     */
+    void animateCamera(float time) {
+        const Vector<float, 3> target = {0.0f, 0.0f, -10.0f};
+        const float radius = 10.0f, height = 2.0f, angle = 0.5f * time;
+
+        camera->setPosition(target + Vector<float, 3>({radius * sinf(angle), height, radius * cosf(angle)}));
+        camera->setRotation({atanf(height / radius), -angle, 0.0f});
+    };
+
     void cleanup() {
         meshes.clear();
+        field.reset();
         camera.reset();
     };
 }  // namespace Engine
@@ -104,10 +201,172 @@ void handleEvents(SDL_Event* event, float deltaTime) {
     }
 }
 
-int main() {
-    Window& window = Window::getInstance();
+/**
+ * Parses value as a positive integer for the argument arg, reporting it if it is not one.
+ *
+ * @return False if value was rejected, in which case out is left unchanged.
+ */
+static bool parsePositive(const std::string& arg, const std::string& value, int& out) {
+    int parsed = 0;
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), parsed);
+    if (error != std::errc() || end != value.data() + value.size() || parsed <= 0) {
+        std::cerr << "Invalid value for " << arg << ": " << value << " (expected a positive integer)" << std::endl;
+        return false;
+    }
+    out = parsed;
+    return true;
+}
+
+/**
+ * Reads the command line into Settings. Unknown arguments are ignored, but an
+ * argument with a value the engine cannot use is an error.
+ *
+ * @return False if an argument was rejected.
+ */
+bool parseArgs(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--headless") Settings::headless = true;
+        else if (arg == "--frames" && hasValue) {
+            if (!parsePositive(arg, argv[++i], Settings::frames)) return false;
+        }
+        else if (arg == "--out" && hasValue) Settings::outputDir = argv[++i];
+        else if (arg == "--format" && hasValue) {
+            // saveImage() picks the encoder from the extension, so only formats it can write are accepted
+            Settings::outputFormat = argv[++i];
+            if (Settings::outputFormat != "ppm" && Settings::outputFormat != "png") {
+                std::cerr << "Unsupported image format: " << Settings::outputFormat << " (expected ppm or png)" << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--bench") Settings::benchmark = true;
+        else if (arg == "--json" && hasValue) Settings::jsonPath = argv[++i];
+        else if (arg == "--fill" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode != "scanline" && mode != "halfspace") {
+                std::cerr << "Unsupported fill mode: " << mode << " (expected scanline or halfspace)" << std::endl;
+                return false;
+            }
+            Settings::fillMode = mode == "scanline" ? SCANLINE : HALF_SPACE;
+        }
+        else if (arg == "--cull" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode != "none" && mode != "front" && mode != "back") {
+                std::cerr << "Unsupported cull mode: " << mode << " (expected none, front or back)" << std::endl;
+                return false;
+            }
+            Settings::cullMode = mode == "none" ? CULL_NONE : mode == "front" ? CULL_FRONT : CULL_BACK;
+        }
+        else if (arg == "--shading" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode != "forward" && mode != "deferred") {
+                std::cerr << "Unsupported shading mode: " << mode << " (expected forward or deferred)" << std::endl;
+                return false;
+            }
+            Settings::shadingMode = mode == "deferred" ? DEFERRED : FORWARD;
+        }
+        else if (arg == "--texture-layout" && hasValue) {
+            std::string layout = argv[++i];
+            if (layout != "linear" && layout != "tiled") {
+                std::cerr << "Unsupported texture layout: " << layout << " (expected linear or tiled)" << std::endl;
+                return false;
+            }
+            Settings::textureLayout = layout == "tiled" ? TEXTURE_TILED : TEXTURE_LINEAR;
+        }
+        else if (arg == "--field" && hasValue) {
+            if (!parsePositive(arg, argv[++i], Settings::fieldSize)) return false;
+        }
+        else if (arg == "--no-optimize") Settings::optimizeMeshes = false;
+        else std::cerr << "Ignoring unknown argument: " << arg << std::endl;
+    }
+    return true;
+}
+
+/**
+ * Renders Settings::frames frames of the scripted animation with a fixed time step
+ * and reports the render throughput. If an output directory is given, every frame
+ * is written there as frame_NNNN.ppm (or .png).
+ */
+int runHeadless(Window& window) {
+    uint64_t startTime = SDL_GetPerformanceCounter();
+
+    for (int frame = 0; frame < Settings::frames; frame++) {
+        Engine::animateCamera(frame * Settings::frameTime);
+        window.clear();
+        Engine::update(Settings::frameTime);
+        window.render();
+
+        if (Settings::outputDir.empty()) continue;
+        std::stringstream path;
+        path << Settings::outputDir << "/frame_" << std::setw(4) << std::setfill('0') << frame << "." << Settings::outputFormat;
+        if (!window.saveImage(path.str())) std::cerr << "Failed to save image: " << path.str() << std::endl;
+    }
+
+    float seconds = float(SDL_GetPerformanceCounter() - startTime) / SDL_GetPerformanceFrequency();
+    std::cout << "Rendered " << Settings::frames << " frames in " << seconds << "s ("
+              << (seconds > 0 ? Settings::frames / seconds : 0) << " FPS)" << std::endl;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Renders the static benchmark scene along the scripted camera path and writes the
+ * frame time statistics, including the per-stage breakdown, as JSON to Settings::jsonPath
+ * (or stdout). The first Settings::warmupFrames frames are not recorded.
+ */
+int runBenchmark(Window& window) {
+    Profiler& profiler = Profiler::getInstance();
+    profiler.setEnabled(true);
+    profiler.setConfig("fill", Settings::fillMode == SCANLINE ? "scanline" : "half_space");
+    profiler.setConfig("cull", Settings::cullMode == CULL_NONE ? "none" : Settings::cullMode == CULL_FRONT ? "front" : "back");
+    profiler.setConfig("shading", Settings::shadingMode == DEFERRED ? "deferred" : "forward");
+    profiler.setConfig("texture_layout", Settings::textureLayout == TEXTURE_LINEAR ? "linear" : "tiled");
+    profiler.setConfig("field", std::to_string(Settings::fieldSize));
+
+    for (int frame = -Settings::warmupFrames; frame < Settings::frames; frame++) {
+        if (frame == 0) profiler.reset();
+        profiler.beginFrame();
+
+        Engine::animateCamera(frame * Settings::frameTime);
+        window.clear();
+        Engine::draw();
+        window.render();
+
+        profiler.endFrame();
+    }
+
+    if (Settings::jsonPath.empty()) {
+        profiler.writeJSON(std::cout);
+        return EXIT_SUCCESS;
+    }
+
+    std::ofstream file(Settings::jsonPath);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open JSON file: " << Settings::jsonPath << std::endl;
+        return EXIT_FAILURE;
+    }
+    profiler.writeJSON(file);
+    std::cout << "Benchmark results written to " << Settings::jsonPath << std::endl;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    if (!parseArgs(argc, argv)) return EXIT_FAILURE;
+    Window& window = Window::getInstance(800, 600, 0x000000FF, Settings::headless);
+    Rasterizer::getInstance().setFillMode(Settings::fillMode);
+    Rasterizer::getInstance().setCullMode(Settings::cullMode);
+    Rasterizer::getInstance().setShadingMode(Settings::shadingMode);
+    Texture::setDefaultLayout(Settings::textureLayout);
     SDL_Event event;
-    Engine::setup();
+    Settings::benchmark ? Engine::setupBenchmark() : Engine::setup();
+
+    if (Settings::benchmark || Settings::headless) {
+        int status = Settings::benchmark ? runBenchmark(window) : runHeadless(window);
+        Engine::cleanup();
+        window.quit();
+        return status;
+    }
 
     uint32_t lastTime = SDL_GetTicks();
     while (State::running) {
@@ -0,0 +1,63 @@
+#include "mappedfile.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Maps the file at the given path into memory.
+ *
+ * The mapping is private and read-only. Empty files are not mapped and
+ * produce an empty view. On Windows the file is read into a buffer instead.
+ *
+ * @param path The path of the file to map.
+ * @throws std::runtime_error If the file cannot be opened or mapped.
+ */
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file: " + path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    buffer = ss.str();
+    address = buffer.data();
+    length = buffer.size();
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Failed to open file: " + path);
+
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        close(fd);
+        throw std::runtime_error("Failed to stat file: " + path);
+    }
+
+    length = info.st_size;
+    if (length > 0) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        address = static_cast<const char*>(mapping);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (address) munmap(const_cast<char*>(address), length);
+#endif
+}
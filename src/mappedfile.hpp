@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * A read-only view of a whole file, memory-mapped where the platform supports it
+ * so that the file is paged in on demand instead of being copied into a buffer.
+ */
+class MappedFile {
+   private:
+    const char* address = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    std::string buffer;
+#endif
+
+   public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return address; }
+    size_t size() const { return length; }
+    std::string_view view() const { return std::string_view(address, length); }
+};
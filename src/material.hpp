@@ -1,8 +1,9 @@
 #pragma once
 
 #include "linalg.hpp"
+#include "texture.hpp"
+#include <memory>
 #include <string>
-#include <SDL2/SDL.h>
 
 struct Material {
     std::string name;
@@ -11,5 +12,5 @@ struct Material {
     Vector<float, 3> diffuse;
     Vector<float, 3> specular;
     std::string texturePath;
-    SDL_Surface* image;
+    std::shared_ptr<Texture> texture;  // Shared with every other material using the same image, see TextureCache
 };
\ No newline at end of file
@@ -1,79 +1,440 @@
 #include "mesh.hpp"
 
+#include <algorithm>
+
+#include "clip.hpp"
+#include "meshcache.hpp"
 #include "parser.hpp"
+#include "profiler.hpp"
+#include "rasterizer.hpp"
+#include "simplify.hpp"
 #include "triangle.hpp"
 
+// Each level of detail has at most this many levels below it
+#define MAX_LOD_LEVELS 8
+// Objects with fewer triangles than this are not simplified further
+#define MIN_LOD_TRIANGLES 64
+// No level of detail has an error larger than this fraction of the Object's bounding radius
+#define MAX_LOD_ERROR 0.05f
+// The coarsest level whose simplification error covers at most this many pixels on screen is drawn
+#define LOD_PIXEL_ERROR 1.0f
+
 /**
  * @brief Constructs a Mesh from the specified model file.
  *
- * This constructor initializes the Mesh by parsing the model file
- * located at the given path. It uses a Parser to read the file and
- * populate the Mesh's internal data structures with objects and materials.
- * After parsing, it sets the Mesh's center to its calculated center of mass.
+ * This constructor initializes the Mesh from the binary cache next to the
+ * model folder if it is up to date with the model's files. Otherwise it uses
+ * a Parser to read the model files and populate the Mesh's internal data
+ * structures with objects and materials. It then sets the Mesh's center to its
+ * calculated center of mass, merges the bounds of its objects into the bounds
+ * of the Mesh and builds a BVH over the triangles of each object. Unless
+ * disabled, the triangles of every BVH leaf and the vertices of every object
+ * are then reordered for vertex locality. Finally, a chain of simplified levels
+ * of detail is generated for each object, and all of it is written to a new cache.
  *
  * @param modelPath The path to the model file to be loaded.
+ * @param optimize Whether to reorder triangles and vertices after loading.
  */
-Mesh::Mesh(const std::string& modelPath) : window(Window::getInstance()) {
+Mesh::Mesh(const std::string& modelPath, bool optimize) : window(Window::getInstance()) {
+    MeshCache cache(modelPath, optimize, objects, materials);
+    if (cache.load()) {
+        for (auto& [name, obj] : objects) bounds.merge(obj.bounds);
+        return;
+    }
+
     Parser parser(objects, materials);
     parser.parse(modelPath);
     this->setCenter(this->getCenterOfMass());
+    for (auto& [name, obj] : objects) {
+        obj.bvh.build(obj);
+        if (optimize) obj.bvh.optimize(obj);
+        buildLODs(obj, optimize);
+    }
+    cache.save();
+}
+
+/**
+ * @brief Generates the levels of detail of an Object.
+ *
+ * Each level is simplified from the one before it to half of its triangles, and
+ * gets its own BVH. The chain ends once a level would have fewer than
+ * MIN_LOD_TRIANGLES triangles, or once simplification removes less than a
+ * quarter of the triangles because it got stuck on seams and borders or would
+ * exceed MAX_LOD_ERROR.
+ *
+ * @param obj The Object to generate levels of detail for. Its model vertices must be final.
+ * @param optimize Whether to reorder the triangles and vertices of each level.
+ */
+void Mesh::buildLODs(Object& obj, bool optimize) {
+    obj.lods.clear();
+    const Object* previous = &obj;
+    while (obj.lods.size() < MAX_LOD_LEVELS && previous->triangleCount() / 2 >= MIN_LOD_TRIANGLES) {
+        Object lod;
+        // Errors add up along the chain, since each level is simplified from the one before it
+        const float maxError = MAX_LOD_ERROR * obj.bounds.sphere.radius - previous->error;
+        const float error = simplify(*previous, previous->triangleCount() / 2, maxError, lod);
+        if (lod.triangleCount() > previous->triangleCount() / 4 * 3) break;
+
+        lod.error = previous->error + error;
+        lod.bvh.build(lod);
+        if (optimize) lod.bvh.optimize(lod);
+        obj.lods.push_back(std::move(lod));
+        previous = &obj.lods.back();
+    }
+}
+
+/**
+ * Collects the vertex range of each leaf and merges overlapping or adjacent
+ * ranges, so that every vertex is covered by exactly one of the resulting ranges.
+ */
+static void mergeRanges(const std::vector<const BVHNode*>& leaves, std::vector<IndexRange>& ranges) {
+    ranges.clear();
+    for (const BVHNode* leaf : leaves) ranges.push_back(leaf->vertices);
+    std::sort(ranges.begin(), ranges.end(), [](const IndexRange& a, const IndexRange& b) { return a.first < b.first; });
+
+    size_t count = 0;
+    for (const IndexRange& range : ranges) {
+        if (count > 0 && range.first <= ranges[count - 1].last) {
+            ranges[count - 1].last = std::max(ranges[count - 1].last, range.last);
+        } else {
+            ranges[count++] = range;
+        }
+    }
+    ranges.resize(count);
+}
+
+/**
+ * Returns twice the signed screen-space area of a triangle whose vertices are in
+ * device coordinates, at base plus their index in the Object's vertices. Front
+ * faces have a negative area.
+ */
+static float twiceArea(const Object& obj, ptrdiff_t base, uint32_t triangle) {
+    const uint32_t* corners = &obj.indices[3 * triangle];
+    const float* x = obj.vertices.data(0);
+    const float* y = obj.vertices.data(1);
+    const ptrdiff_t a = base + corners[0], b = base + corners[1], c = base + corners[2];
+    return (x[b] - x[a]) * (y[c] - y[a]) - (y[b] - y[a]) * (x[c] - x[a]);
 }
 
 /**
- * @brief Destructor for the Mesh class.
+ * @brief Collects the triangles of the visible leaves that can cover any pixels.
+ *
+ * Triangles entirely outside one frustum plane are dropped, and so are triangles
+ * the cull mode rejects by their winding or that have no area on screen. The
+ * winding of a triangle crossing the near or far plane is meaningless before it
+ * is clipped, so those triangles are kept and tested again after clipping.
  *
- * This destructor releases resources held by the Mesh, specifically freeing
- * the SDL_Surface associated with each material's image. It iterates through
- * the materials map and calls SDL_FreeSurface on each material's image to
- * prevent memory leaks.
+ * @param obj The Object, with its vertices in device coordinates.
+ * @param base The offset of the vertices and clip codes of the instance being drawn.
+ * @param leaves The visible leaves, in triangle order.
+ * @param mode The cull mode.
+ * @param triangles Receives the remaining triangles in ascending order.
  */
-Mesh::~Mesh() {
-    for (auto& [name, mat] : materials) {
-        SDL_FreeSurface(mat.image);
+static void cullTriangles(const Object& obj, ptrdiff_t base, const std::vector<const BVHNode*>& leaves, CullMode mode,
+                          std::vector<uint32_t>& triangles) {
+    const uint8_t* codes = obj.clipCodes.data();
+    triangles.clear();
+    for (const BVHNode* leaf : leaves) {
+        for (uint32_t t = leaf->first; t < leaf->first + leaf->count; t++) {
+            const uint32_t* corners = &obj.indices[3 * t];
+            uint8_t c0 = codes[base + corners[0]];
+            uint8_t c1 = codes[base + corners[1]];
+            uint8_t c2 = codes[base + corners[2]];
+
+            // Every vertex is outside the same plane, so the triangle cannot be visible
+            if (c0 & c1 & c2) continue;
+            if (!((c0 | c1 | c2) & (CLIP_NEAR | CLIP_FAR)) && isCulled(twiceArea(obj, base, t), mode)) continue;
+            triangles.push_back(t);
+        }
     }
 }
 
 /**
- * @brief Draws the Mesh to the screen using the given Camera.
+ * @brief Picks the level of detail of an Object to draw.
  *
- * The function renders each triangle in the Mesh's list of triangles.
- * It first transforms the triangle's vertices using the Mesh's current
- * transformation matrix. Then, it projects the transformed vertices using
- * the given Camera's projection matrix. Next, it converts the projected
- * vertices to screen coordinates using the Camera's screenToNDC function.
- * Finally, it renders the triangle to the screen using either the Triangle's
- * draw or fill functions depending on the wireFrame parameter.
+ * The simplification error of each level is projected to the screen at the
+ * distance of the nearest point of the Object's bounding sphere, and the
+ * coarsest level whose error stays within LOD_PIXEL_ERROR pixels is chosen.
+ *
+ * @param obj The Object at full detail.
+ * @param viewTransform The model-view matrix of the Mesh.
+ * @param pixelsPerUnit How many pixels a model-space length of 1 covers at a view distance of 1.
+ * @return The Object itself or one of its levels of detail.
+ */
+static Object& selectLOD(Object& obj, const Matrix<float, 4, 4>& viewTransform, float pixelsPerUnit) {
+    if (obj.lods.empty() || obj.bounds.sphere.radius < 0) return obj;
+
+    // The largest scale of the model transform, so the error is never underestimated
+    float scale = 0;
+    for (size_t i = 0; i < 3; i++) {
+        scale = std::max(scale, Vector<float, 3>({viewTransform[0][i], viewTransform[1][i], viewTransform[2][i]}).norm());
+    }
+    Vector<float, 4> center(obj.bounds.sphere.center);
+    center[3] = 1.0f;
+    const float distance = -(viewTransform * center)[2] - obj.bounds.sphere.radius * scale;
+    if (distance <= 0) return obj;
+
+    Object* selected = &obj;
+    for (Object& lod : obj.lods) {
+        if (lod.error * scale * pixelsPerUnit / distance > LOD_PIXEL_ERROR) break;
+        selected = &lod;
+    }
+    return *selected;
+}
+
+/**
+ * @brief Draws every instance of the Mesh to the screen using the given Camera.
+ *
+ * Each instance is drawn with the Mesh's world transform applied after its own,
+ * using the camera transforms kept by updateInstanceViews(). Instances
+ * whose bounding volumes lie outside the camera frustum are skipped before any
+ * other work is done for them, and each object of a remaining instance is drawn
+ * at the level of detail its size on screen calls for, if it is in the frustum
+ * itself. Of that level, only the BVH leaves inside the frustum are transformed.
+ * The vertices and normals of all of these are transformed in one batched pass,
+ * with every instance of an object writing to its own part of the object's
+ * arrays, and the instances are spread over threads when there are several.
+ * Of the triangles of the visible leaves, a cull stage discards those entirely
+ * outside one frustum plane and those facing away or without area according to
+ * the Rasterizer's cull mode, before any per-triangle setup. Triangles crossing
+ * the near or far plane are clipped against it.
+ * Finally, it either draws each triangle's outline directly or bins the
+ * triangle into screen tiles. The tiles are filled by Rasterizer::flush() and
+ * resolve() once every Mesh of the frame has been drawn, so the Mesh's clipped
+ * triangles and transformed vertices are kept until its next draw.
  *
  * @param camera The Camera to use for rendering.
  * @param wireFrame Whether to draw the Mesh in wireframe (true) or filled (false).
  */
 void Mesh::draw(Camera* camera, bool wireFrame) {
+    Rasterizer& rasterizer = Rasterizer::getInstance();
+    Profiler& profiler = Profiler::getInstance();
+    const Viewport viewport = window.getViewport();
+    const CullMode cullMode = rasterizer.getCullMode();
+
+    clipped.vertices.resize(0);
+    clipped.textures.clear();
+    clipped.normals.resize(0);
+    clipped.clearTriangles();
+
+    // A view-space length of 1 at distance 1 spans projection[1][1] in NDC, and NDC spans scale / 2 pixels
+    const float pixelsPerUnit = camera->getProjection()[1][1] * viewport.scale / 2;
+
     for (auto& [name, obj] : objects) {
-        const Matrix<float, 4, 4> viewTransform = camera->getView() * transform;
-        const Matrix<float, 4, 4> fullTransform = camera->getProjection() * viewTransform;
+        obj.drawnVertexCount = 0;
+        for (Object& lod : obj.lods) lod.drawnVertexCount = 0;
+    }
 
-        // const uint32_t startTime = SDL_GetTicks();
-        #pragma omp parallel for schedule(static)
-        for (size_t i = 1; i < obj.modelVertices.size(); i++) {
-            Vector<float, 4> vertex = obj.modelVertices[i];
-            vertex[3] = 1.0f;
-            obj.vertices[i] = window.toDeviceCoordinates(fullTransform * vertex);
+    updateInstanceViews(camera);
+    drawCount = 0;
+    for (const InstanceView& view : instanceViews) {
+        const Matrix<float, 4, 4>& viewTransform = view.viewTransform;
+        const Matrix<float, 4, 4>& fullTransform = view.fullTransform;
+        const Frustum& frustum = view.frustum;
+        if (!frustum.intersects(bounds)) continue;
+
+        for (auto& [name, detailed] : objects) {
+            Object& obj = selectLOD(detailed, viewTransform, pixelsPerUnit);
+            if (!frustum.intersects(obj.bounds)) continue;
+
+            if (drawCount == draws.size()) draws.emplace_back();
+            ObjectDraw& draw = draws[drawCount];
+            draw.leaves.clear();
+            obj.bvh.cull(frustum, draw.leaves);
+            if (draw.leaves.empty()) continue;
+
+            // The instance's part only spans its visible vertices. It starts on a whole SIMD
+            // block, at the same offset within the block as the model vertices it is computed from.
+            mergeRanges(draw.leaves, draw.ranges);
+            const size_t first = draw.ranges.front().first / SIMD_WIDTH * SIMD_WIDTH;
+            draw.obj = &obj;
+            draw.base = ptrdiff_t(obj.drawnVertexCount) - ptrdiff_t(first);
+            obj.drawnVertexCount += VertexArray<3>::padded(draw.ranges.back().last - first);
+            draw.viewTransform = viewTransform;
+            draw.fullTransform = fullTransform;
+            drawCount++;
         }
-        // std::cout << "Time to transform vertices: " << SDL_GetTicks() - startTime << std::endl;
+    }
+
+    // Normals are sized even in wireframe, where they are not transformed, because clipping copies them
+    for (size_t i = 0; i < drawCount; i++) {
+        Object& obj = *draws[i].obj;
+        obj.vertices.resize(obj.drawnVertexCount);
+        obj.clipCodes.resize(obj.drawnVertexCount);
+        obj.normals.resize(obj.drawnVertexCount);
+    }
+
+    uint64_t startTime = profiler.now();
+    #pragma omp parallel for schedule(dynamic) if (drawCount > 1)
+    for (size_t i = 0; i < drawCount; i++) {
+        ObjectDraw& draw = draws[i];
+        Object& obj = *draw.obj;
+        for (const IndexRange& range : draw.ranges) {
+            const size_t first = draw.base + range.first;
+            const float* positions[] = {obj.modelVertices.data(0) + range.first, obj.modelVertices.data(1) + range.first,
+                                        obj.modelVertices.data(2) + range.first};
+            float* devicePositions[] = {obj.vertices.data(0) + first, obj.vertices.data(1) + first, obj.vertices.data(2) + first};
+            transformToViewport(draw.fullTransform, positions, devicePositions, obj.clipCodes.data() + first,
+                                range.last - range.first, viewport);
+        }
+    }
+    profiler.record(VERTEX_TRANSFORM, startTime);
 
-        if (!wireFrame) {
-            #pragma omp parallel for schedule(static)
-            for (size_t i = 1; i < obj.modelNormals.size(); i++) {
-                obj.normals[i] = (viewTransform * obj.modelNormals[i]).normalize();
+    startTime = profiler.now();
+    if (!wireFrame) {
+        #pragma omp parallel for schedule(dynamic) if (drawCount > 1)
+        for (size_t i = 0; i < drawCount; i++) {
+            const ObjectDraw& draw = draws[i];
+            Object& obj = *draw.obj;
+            for (const IndexRange& range : draw.ranges) {
+                const size_t first = draw.base + range.first;
+                const float* normals[] = {obj.modelNormals.data(0) + range.first, obj.modelNormals.data(1) + range.first,
+                                          obj.modelNormals.data(2) + range.first};
+                float* viewNormals[] = {obj.normals.data(0) + first, obj.normals.data(1) + first, obj.normals.data(2) + first};
+                transformNormals(draw.viewTransform, normals, viewNormals, range.last - range.first);
             }
         }
-        // std::cout << "Time to transform normals: " << SDL_GetTicks() - startTime << std::endl;
-        
-        // #pragma omp parallel for schedule(dynamic)
-        for (auto& triangle : obj.triangles) {
-            wireFrame ? triangle->draw() : triangle->fill();
+    }
+    profiler.record(NORMAL_TRANSFORM, startTime);
+
+    startTime = profiler.now();
+    #pragma omp parallel for schedule(dynamic) if (drawCount > 1)
+    for (size_t i = 0; i < drawCount; i++) {
+        ObjectDraw& draw = draws[i];
+        cullTriangles(*draw.obj, draw.base, draw.leaves, cullMode, draw.triangles);
+    }
+    profiler.record(CULL, startTime);
+
+    startTime = profiler.now();
+    for (size_t d = 0; d < drawCount; d++) {
+        const ObjectDraw& draw = draws[d];
+        const Object& obj = *draw.obj;
+        size_t range = 0;
+        for (uint32_t t : draw.triangles) {
+            while (obj.materialRanges[range].first + obj.materialRanges[range].count <= t) range++;
+            const Material& material = *obj.materialRanges[range].material;
+
+            // Crossing the near or far plane: rasterize the clipped polygon instead.
+            // Triangles only crossing the side planes are left to the screen-space bounds.
+            const uint8_t* codes = obj.clipCodes.data();
+            const uint32_t* corners = &obj.indices[3 * t];
+            uint8_t planes = codes[draw.base + corners[0]] | codes[draw.base + corners[1]] | codes[draw.base + corners[2]];
+            if (planes & (CLIP_NEAR | CLIP_FAR)) {
+                uint32_t first = clipped.triangleCount();
+                clip(obj, draw.base, t, material, draw.fullTransform, planes);
+                for (uint32_t i = first; i < clipped.triangleCount(); i++) {
+                    if (isCulled(twiceArea(clipped, 0, i), cullMode)) continue;
+                    Triangle triangle(clipped, i, material);
+                    wireFrame ? triangle.draw() : rasterizer.bin(triangle);
+                }
+                continue;
+            }
+
+            Triangle triangle(obj, t, material, draw.base);
+            wireFrame ? triangle.draw() : rasterizer.bin(triangle);
         }
-        // std::cout << "Time to draw: " << SDL_GetTicks() - startTime << std::endl;
+    }
+    profiler.record(BINNING, startTime);
+}
+
+/**
+ * @brief Brings the camera transforms of every instance up to date.
+ *
+ * They are only rebuilt when the camera, the world transform of the Mesh or the
+ * instances changed since the last frame, so a Mesh that does not move costs no
+ * matrix math while the camera stands still.
+ *
+ * @param camera The Camera the Mesh is about to be drawn with.
+ */
+void Mesh::updateInstanceViews(Camera* camera) {
+    const uint64_t worldVersion = getVersion();
+    if (!instancesChanged && viewCamera == camera && viewCameraVersion == camera->getVersion() &&
+        viewWorldVersion == worldVersion)
+        return;
+
+    const Matrix<float, 4, 4> viewWorld = camera->getView() * getWorldTransform();
+    const Matrix<float, 4, 4> projection = camera->getProjection();
+    instanceViews.resize(instances.size());
+    #pragma omp parallel for schedule(static) if (instances.size() >= 1024)
+    for (size_t i = 0; i < instances.size(); i++) {
+        const Matrix<float, 4, 4> viewTransform = viewWorld * instances[i];
+        const Matrix<float, 4, 4> fullTransform = projection * viewTransform;
+        instanceViews[i] = InstanceView{viewTransform, fullTransform, Frustum(fullTransform)};
+    }
+
+    viewCamera = camera;
+    viewCameraVersion = camera->getVersion();
+    viewWorldVersion = worldVersion;
+    instancesChanged = false;
+}
+
+/**
+ * @brief Finds the nearest triangle of the Mesh hit by a ray.
+ *
+ * The ray is moved into the model space of each instance of the Mesh and tested
+ * against the BVH of each object. Hit distances are measured along the ray's
+ * direction, which an affine transform preserves, so one RayHit can be passed to
+ * several Meshes in turn to pick the nearest hit among them.
+ *
+ * @param ray The ray, in world space.
+ * @param hit The nearest hit so far, updated if the Mesh is hit closer.
+ * @return Whether the Mesh was hit closer than the hit passed in.
+ */
+bool Mesh::intersect(const Ray& ray, RayHit& hit) {
+    bool found = false;
+    for (uint32_t i = 0; i < instances.size(); i++) {
+        const Matrix<float, 4, 4> inverse = (getWorldTransform() * instances[i]).inverse_affine();
+        Vector<float, 4> origin(ray.origin), direction(ray.direction);
+        origin[3] = 1.0f;
+        const Ray local = {Vector<float, 3>(inverse * origin), Vector<float, 3>(inverse * direction)};
+
+        bool hitInstance = false;
+        for (auto& [name, obj] : objects) hitInstance |= obj.bvh.intersect(local, obj, hit);
+        if (hitInstance) hit.instance = i;
+        found |= hitInstance;
+    }
+    return found;
+}
+
+/**
+ * @brief Clips a triangle against the near and far planes.
+ *
+ * The triangle is rebuilt in clip space and clipped there. The resulting polygon
+ * is projected and fanned into new triangles, which are added to the clipped
+ * scratch object. Vertices the clipping did not move keep the device coordinates
+ * computed for their object, so edges shared with unclipped neighbours stay exact.
+ *
+ * @param obj The Object the triangle belongs to.
+ * @param base The offset of the vertices and normals of the instance being drawn.
+ * @param triangle The index of the triangle to clip.
+ * @param material The material of the triangle.
+ * @param fullTransform The model-view-projection matrix of the Object.
+ * @param planes The ClipPlane bits of the planes the triangle crosses.
+ */
+void Mesh::clip(const Object& obj, ptrdiff_t base, uint32_t triangle, const Material& material,
+                const Matrix<float, 4, 4>& fullTransform, uint8_t planes) {
+    ClipVertex in[3], polygon[MAX_CLIP_VERTICES];
+    for (size_t i = 0; i < 3; i++) {
+        const uint32_t vertex = obj.indices[3 * triangle + i];
+        Vector<float, 4> position = obj.modelVertices[vertex];
+        position[3] = 1.0f;
+        in[i] = ClipVertex{fullTransform * position, obj.textures[vertex], obj.normals[base + vertex], int(vertex)};
+    }
+
+    size_t count = clipTriangle(in, planes, polygon);
+    if (count < 3) return;
+
+    uint32_t first = clipped.vertices.size();
+    for (size_t i = 0; i < count; i++) {
+        const ClipVertex& vertex = polygon[i];
+        clipped.vertices.push_back(vertex.index >= 0 ? obj.vertices[base + vertex.index] : Vector<float, 3>(window.toDeviceCoordinates(vertex.position)));
+        clipped.textures.push_back(vertex.uv);
+        clipped.normals.push_back(vertex.normal);
+    }
+
+    for (uint32_t i = 1; i + 1 < count; i++) {
+        uint32_t idx[] = {first, first + i, first + i + 1};
+        clipped.addTriangle(idx, material);
     }
 }
 
@@ -87,11 +448,13 @@ void Mesh::draw(Camera* camera, bool wireFrame) {
  * @param center The new center position of the Mesh in 3D space.
  */
 void Mesh::setCenter(Vector<float, 3> center) {
-    Vector<float, 4> center4 = Vector<float, 4>(center);
+    bounds = Bounds();
     for (auto& [name, obj] : objects) {
         for (size_t i = 1; i < obj.modelVertices.size(); i++) {
-            obj.modelVertices[i] = obj.modelVertices[i] - center4;
+            obj.modelVertices.set(i, obj.modelVertices[i] - center);
         }
+        obj.bounds.translate(center * -1.0f);
+        bounds.merge(obj.bounds);
     }
 }
 
@@ -120,33 +483,34 @@ void Mesh::printObjects() {
     for (auto& [name, obj] : objects) {
         std::cout << "\nObject: " << name << ":\n";
         std::cout << "\nVertices:\n";
-        for (auto& vertex : obj.modelVertices) {
-            vertex.print();
+        for (size_t i = 0; i < obj.modelVertices.size(); i++) {
+            obj.modelVertices[i].print();
         }
         std::cout << "\nTextures:\n";
         for (auto& texture : obj.textures) {
             texture.print();
         }
         std::cout << "\nNormals:\n";
-        for (auto& normal : obj.modelNormals) {
-            normal.print();
+        for (size_t i = 0; i < obj.modelNormals.size(); i++) {
+            obj.modelNormals[i].print();
         }
-        int i = 0;
         std::cout << "\nTriangles:\n";
-        for (auto& triangle : obj.triangles) {
-            std::cout << "\nTriangle: " << ++i << " \n";
-            triangle->print();
-        }
+        printTriangles(obj);
     }
 }
 
 void Mesh::printTriangles() {
     for (auto& [name, obj] : objects) {
         std::cout << "\nObject: " << name << ":\n";
-        int i = 0;
-        for (auto& triangle : obj.triangles) {
-            std::cout << "\nTriangle: " << ++i << " \n";
-            triangle->print();
+        printTriangles(obj);
+    }
+}
+
+void Mesh::printTriangles(const Object& obj) {
+    for (const MaterialRange& range : obj.materialRanges) {
+        for (uint32_t i = range.first; i < range.first + range.count; i++) {
+            std::cout << "\nTriangle: " << i + 1 << " \n";
+            Triangle(obj, i, *range.material).print();
         }
     }
 }
@@ -3,39 +3,83 @@
 #include <SDL2/SDL.h>
 
 #include <unordered_map>
+#include <vector>
 
 #include "camera.hpp"
 #include "linalg.hpp"
 #include "material.hpp"
 #include "object.hpp"
+#include "scenenode.hpp"
 #include "window.hpp"
 
-class Mesh {
+class Mesh : public SceneNode {
     private:
+    /**
+     * One Object of one visible instance, at the level of detail that instance is
+     * drawn with, together with the scratch lists of its BVH leaves, vertex ranges
+     * and triangles visible in the current frame.
+     */
+    struct ObjectDraw {
+        Object* obj;
+        // Added to a vertex index to find it in the instance's part of the Object's vertices,
+        // normals and clip codes. Negative when the visible vertices start past the part's start.
+        ptrdiff_t base;
+        Matrix<float, 4, 4> viewTransform, fullTransform;
+        std::vector<const BVHNode*> leaves;
+        std::vector<IndexRange> ranges;
+        std::vector<uint32_t> triangles;
+    };
+
+    /**
+     * The transforms of one instance that depend on the camera, kept between frames.
+     */
+    struct InstanceView {
+        Matrix<float, 4, 4> viewTransform, fullTransform;
+        Frustum frustum;
+    };
+
     Window& window;
     std::unordered_map<std::string, Object> objects;
     std::unordered_map<std::string, Material> materials;
 
-    Matrix<float, 4, 4> transform;
-    Vector<float, 3> rotation;
+    Bounds bounds;
+    // The transform of each copy of the Mesh that is drawn, applied before the Mesh's world transform
+    std::vector<Matrix<float, 4, 4>> instances = {Matrix<float, 4, 4>()};
+
+    // The camera transforms of every instance, and what they were last built from
+    std::vector<InstanceView> instanceViews;
+    const Camera* viewCamera = nullptr;
+    uint64_t viewCameraVersion = 0, viewWorldVersion = 0;
+    bool instancesChanged = true;
+    void updateInstanceViews(Camera* camera);
+
+    // Holds the triangles created by near/far clipping during the current frame
+    Object clipped;
+    // The Objects to draw in the current frame, in the order their triangles are binned.
+    // Only the first drawCount are used, the others keep their scratch lists for later frames.
+    std::vector<ObjectDraw> draws;
+    size_t drawCount = 0;
+    void clip(const Object& obj, ptrdiff_t base, uint32_t triangle, const Material& material,
+              const Matrix<float, 4, 4>& fullTransform, uint8_t planes);
+    void printTriangles(const Object& obj);
+    void buildLODs(Object& obj, bool optimize);
 
     public:
-    Mesh(const std::string& modelPath);
-    ~Mesh();
-
-    void setScale(float scale) { this->setScale({scale, scale, scale}); };
-    void setScale(Vector<float, 3> scale) { this->transform.set_scale(scale); };
-    void setPosition(Vector<float, 3> position) { this->transform.set_position(position); };
-    Vector<float, 3> getPosition() { return this->transform.get_position(); };
-    Matrix<float, 4, 4> getTransform() { return this->transform; };
-    void setTransform(Matrix<float, 4, 4> transform) { this->transform = transform; };
-    Vector<float, 3> getRotation() { return this->rotation; };
-    void setRotation(Vector<float, 3> rotation) { this->transform.set_rotation3(this->rotation = rotation); };
+    Mesh(const std::string& modelPath, bool optimize = true);
+
+    Bounds getBounds() { return this->bounds; };
+
+    const std::vector<Matrix<float, 4, 4>>& getInstances() { return this->instances; };
+    void setInstances(std::vector<Matrix<float, 4, 4>> instances) {
+        this->instances = std::move(instances);
+        this->instancesChanged = true;
+    };
 
     void setCenter(Vector<float, 3> center);
     Vector<float, 3> getCenterOfMass();
 
     void draw(Camera* camera, bool wireFrame = false);
+    bool intersect(const Ray& ray, RayHit& hit);
     void printObjects();
     void printTriangles();
     void printMaterials();
@@ -0,0 +1,379 @@
+#include "meshcache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "texturecache.hpp"
+
+#define CACHE_MAGIC "MSHC"
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t materialCount;
+    uint32_t objectCount;
+};
+
+struct CacheRange {
+    uint32_t first, count;
+    uint32_t material;
+};
+
+// A cache claiming more levels of detail per object than this is corrupt
+#define MAX_CACHED_LODS 64
+
+/**
+ * Reads values from the mapped cache, failing instead of reading past its end.
+ */
+struct CacheReader {
+    const char* cursor;
+    const char* end;
+
+    bool read(void* out, size_t bytes) {
+        if (size_t(end - cursor) < bytes) return false;
+        memcpy(out, cursor, bytes);
+        cursor += bytes;
+        return true;
+    }
+
+    template <typename T>
+    bool read(T& value) { return read(&value, sizeof(T)); }
+
+    bool read(std::string& value) {
+        uint32_t length;
+        if (!read(length) || size_t(end - cursor) < length) return false;
+        value.assign(cursor, length);
+        cursor += length;
+        return true;
+    }
+
+    bool read(std::vector<uint32_t>& array) {
+        uint32_t size;
+        if (!read(size) || size_t(end - cursor) / sizeof(uint32_t) < size) return false;
+        array.resize(size);
+        return read(array.data(), size * sizeof(uint32_t));
+    }
+
+    bool read(VertexArray<3>& array) {
+        uint32_t size;
+        if (!read(size) || size_t(end - cursor) / (3 * sizeof(float)) < size) return false;
+        array.resize(size);
+        for (size_t c = 0; c < 3; c++) read(array.data(c), size * sizeof(float));
+        return true;
+    }
+
+    bool read(std::vector<BVHNode>& nodes) {
+        uint32_t size;
+        if (!read(size) || size_t(end - cursor) / sizeof(BVHNode) < size) return false;
+        nodes.resize(size);
+        return read(nodes.data(), size * sizeof(BVHNode));
+    }
+};
+
+template <typename T>
+static void write(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void write(std::ostream& out, const std::string& value) {
+    write(out, uint32_t(value.size()));
+    out.write(value.data(), value.size());
+}
+
+static void write(std::ostream& out, const std::vector<uint32_t>& array) {
+    write(out, uint32_t(array.size()));
+    out.write(reinterpret_cast<const char*>(array.data()), array.size() * sizeof(uint32_t));
+}
+
+static void write(std::ostream& out, const VertexArray<3>& array) {
+    write(out, uint32_t(array.size()));
+    for (size_t c = 0; c < 3; c++) out.write(reinterpret_cast<const char*>(array.data(c)), array.size() * sizeof(float));
+}
+
+static void write(std::ostream& out, const std::vector<BVHNode>& nodes) {
+    write(out, uint32_t(nodes.size()));
+    out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(BVHNode));
+}
+
+/**
+ * Checks that every node of a cached BVH only refers to nodes, triangles,
+ * material ranges and vertices that exist, and that children follow their parent.
+ * The triangles of each leaf must lie in its material range and only use vertices
+ * in its vertex range, since drawing sizes and indexes the transformed vertices of
+ * an instance by the vertex ranges of its visible leaves.
+ */
+static bool validNodes(const std::vector<BVHNode>& nodes, const Object& obj) {
+    if (nodes.empty() != (obj.triangleCount() == 0)) return false;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const BVHNode& node = nodes[i];
+        if (!node.leaf()) {
+            if (i + 1 >= nodes.size() || node.first <= i + 1 || node.first >= nodes.size()) return false;
+            continue;
+        }
+        if (uint64_t(node.first) + node.count > obj.triangleCount() || node.material >= obj.materialRanges.size()) return false;
+        if (node.vertices.first >= node.vertices.last || node.vertices.last > obj.modelVertices.size()) return false;
+
+        const MaterialRange& range = obj.materialRanges[node.material];
+        if (node.first < range.first || node.first + node.count > uint64_t(range.first) + range.count) return false;
+        for (size_t j = 3 * size_t(node.first); j < 3 * (size_t(node.first) + node.count); j++) {
+            if (obj.indices[j] < node.vertices.first || obj.indices[j] >= node.vertices.last) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Reads the geometry, bounds and BVH of one object or level of detail.
+ */
+static bool readObject(CacheReader& in, Object& obj, const std::vector<Material*>& table) {
+    uint32_t textureCount;
+    if (!in.read(obj.modelVertices) || !in.read(obj.modelNormals) || !in.read(textureCount)) return false;
+    if (size_t(in.end - in.cursor) / sizeof(Vector<float, 2>) < textureCount) return false;
+    obj.textures.resize(textureCount);
+    in.read(obj.textures.data(), textureCount * sizeof(Vector<float, 2>));
+
+    const size_t vertexCount = obj.modelVertices.size();
+    if (obj.modelNormals.size() != vertexCount || textureCount != vertexCount) return false;
+
+    if (!in.read(obj.indices) || obj.indices.size() % 3 != 0) return false;
+    const size_t triangleCount = obj.triangleCount();
+    for (uint32_t index : obj.indices) {
+        if (index >= vertexCount) return false;
+    }
+
+    uint32_t rangeCount;
+    if (!in.read(rangeCount)) return false;
+    for (uint32_t r = 0, next = 0; r < rangeCount; r++) {
+        CacheRange range;
+        if (!in.read(range) || range.material >= table.size() || range.first != next) return false;
+        next = range.first + range.count;
+        if (next > triangleCount || (r + 1 == rangeCount && next != triangleCount)) return false;
+        obj.materialRanges.push_back(MaterialRange{range.first, range.count, table[range.material]});
+    }
+    if (rangeCount == 0 && triangleCount > 0) return false;
+
+    std::vector<BVHNode> nodes;
+    if (!in.read(obj.bounds) || !in.read(obj.error) || !in.read(nodes) || !validNodes(nodes, obj)) return false;
+    obj.bvh.setNodes(std::move(nodes));
+
+    obj.vertices = obj.modelVertices;
+    obj.normals = obj.modelNormals;
+    return true;
+}
+
+static void writeObject(std::ostream& out, const Object& obj, const std::unordered_map<const Material*, uint32_t>& table) {
+    write(out, obj.modelVertices);
+    write(out, obj.modelNormals);
+    write(out, uint32_t(obj.textures.size()));
+    out.write(reinterpret_cast<const char*>(obj.textures.data()), obj.textures.size() * sizeof(Vector<float, 2>));
+
+    write(out, obj.indices);
+
+    write(out, uint32_t(obj.materialRanges.size()));
+    for (const MaterialRange& range : obj.materialRanges) {
+        write(out, CacheRange{range.first, range.count, table.at(range.material)});
+    }
+
+    write(out, obj.bounds);
+    write(out, obj.error);
+    write(out, obj.bvh.getNodes());
+}
+
+/**
+ * @brief Creates a cache for the model in the given folder.
+ *
+ * @param modelPath The folder containing the model's .obj, .mtl and texture files.
+ * @param optimized Whether the cached triangles and vertices are reordered for vertex locality.
+ * @param objects The map to load objects into, or to save them from.
+ * @param materials The map to load materials into, or to save them from.
+ */
+MeshCache::MeshCache(const std::string& modelPath, bool optimized, std::unordered_map<std::string, Object>& objects,
+                     std::unordered_map<std::string, Material>& materials) : objects(objects), materials(materials) {
+    std::string folder = modelPath;
+    while (folder.size() > 1 && folder.back() == '/') folder.pop_back();
+    path = folder + ".meshcache";
+    sourcesHashed = hashSources(modelPath, optimized, sourceHash);
+}
+
+/**
+ * Hashes the names, sizes and modification times of the files in the model
+ * folder, together with the cache version and whether the triangles are
+ * optimized, using 64-bit FNV-1a.
+ *
+ * @return False if the folder or one of its files could not be read, in which
+ * case the model is parsed instead and the parser reports the problem.
+ */
+bool MeshCache::hashSources(const std::string& modelPath, bool optimized, uint64_t& hash) {
+    std::error_code error;
+    std::vector<std::filesystem::path> files;
+    for (std::filesystem::directory_iterator it(modelPath, error), end; !error && it != end; it.increment(error)) {
+        if (it->is_regular_file(error)) files.push_back(it->path());
+    }
+    if (error) return false;
+    std::sort(files.begin(), files.end());
+
+    hash = 14695981039346656037ull;
+    auto mix = [&](const void* data, size_t size) {
+        for (size_t i = 0; i < size; i++) hash = (hash ^ static_cast<const uint8_t*>(data)[i]) * 1099511628211ull;
+    };
+
+    mix(&VERSION, sizeof(VERSION));
+    mix(&optimized, sizeof(optimized));
+    for (const auto& file : files) {
+        std::string name = file.filename().string();
+        uint64_t size = std::filesystem::file_size(file, error);
+        int64_t time = std::filesystem::last_write_time(file, error).time_since_epoch().count();
+        if (error) return false;
+        mix(name.data(), name.size());
+        mix(&size, sizeof(size));
+        mix(&time, sizeof(time));
+    }
+    return true;
+}
+
+/**
+ * @brief Loads the objects and materials from the cache if it is fresh.
+ *
+ * The cache is memory-mapped and copied straight into the objects' arrays,
+ * so neither the BVHs nor the levels of detail have to be built again.
+ * Textures are stored already converted, so only their mip chains are
+ * rebuilt, and only for textures no other Mesh has loaded.
+ *
+ * @return Whether the cache existed, matched the model's files and was read
+ * completely. If not, the maps are left empty.
+ */
+bool MeshCache::load() {
+    std::error_code error;
+    if (!sourcesHashed || !std::filesystem::is_regular_file(path, error)) return false;
+
+    try {
+        MappedFile file(path);
+        if (read(file.data(), file.size())) return true;
+    } catch (const std::runtime_error&) {
+    }
+
+    clear();
+    return false;
+}
+
+bool MeshCache::read(const char* data, size_t size) {
+    CacheReader in{data, data + size};
+
+    CacheHeader header;
+    if (!in.read(header) || memcmp(header.magic, CACHE_MAGIC, 4) != 0) return false;
+    if (header.version != VERSION || header.sourceHash != sourceHash) return false;
+
+    std::vector<Material*> table;
+    for (uint32_t i = 0; i < header.materialCount; i++) {
+        std::string name;
+        if (!in.read(name)) return false;
+
+        Material& material = materials[name] = Material{name};
+        table.push_back(&material);
+
+        uint32_t hasTexture;
+        if (!in.read(material.shininess) || !in.read(material.ambient) || !in.read(material.diffuse) ||
+            !in.read(material.specular) || !in.read(material.texturePath) || !in.read(hasTexture))
+            return false;
+        if (!hasTexture) continue;
+
+        int32_t w, h;
+        if (!in.read(w) || !in.read(h)) return false;
+        if (w <= 0 || h <= 0 || size_t(in.end - in.cursor) / sizeof(uint32_t) / w < size_t(h)) return false;
+
+        // Textures already loaded by another Mesh are shared, and their texels skipped
+        const char* texels = in.cursor;
+        in.cursor += size_t(w) * h * sizeof(uint32_t);
+        material.texture = TextureCache::getInstance().get(material.texturePath, [&] {
+            std::vector<uint32_t> pixels(size_t(w) * h);
+            memcpy(pixels.data(), texels, pixels.size() * sizeof(uint32_t));
+            return std::make_unique<Texture>(w, h, std::move(pixels));
+        });
+    }
+
+    for (uint32_t i = 0; i < header.objectCount; i++) {
+        std::string name;
+        if (!in.read(name)) return false;
+        Object& obj = objects[name] = Object{name};
+        if (!readObject(in, obj, table)) return false;
+
+        uint32_t lodCount;
+        if (!in.read(lodCount) || lodCount > MAX_CACHED_LODS) return false;
+        obj.lods.resize(lodCount, Object{name});
+        for (Object& lod : obj.lods) {
+            if (!readObject(in, lod, table)) return false;
+        }
+    }
+
+    return in.cursor == in.end;
+}
+
+void MeshCache::clear() {
+    materials.clear();
+    objects.clear();
+}
+
+/**
+ * @brief Writes the objects, their levels of detail and the materials to the cache.
+ *
+ * The cache is written to a temporary file first and renamed over the old one,
+ * so a concurrent or interrupted run never sees a partial cache. Failing to
+ * write the cache is not an error, the model is just parsed again next time.
+ * Nothing is written if the model folder could not be hashed.
+ */
+void MeshCache::save() const {
+    if (!sourcesHashed) return;
+
+    const std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Failed to write mesh cache: " << path << std::endl;
+        return;
+    }
+
+    CacheHeader header = {{}, VERSION, sourceHash, uint32_t(materials.size()), uint32_t(objects.size())};
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    write(out, header);
+
+    std::unordered_map<const Material*, uint32_t> table;
+    for (const auto& [name, material] : materials) {
+        table.emplace(&material, table.size());
+        write(out, name);
+        write(out, material.shininess);
+        write(out, material.ambient);
+        write(out, material.diffuse);
+        write(out, material.specular);
+        write(out, material.texturePath);
+        write(out, uint32_t(material.texture != nullptr));
+        if (!material.texture) continue;
+
+        const Texture& texture = *material.texture;
+        const std::vector<uint32_t> pixels = texture.getPixels();
+        write(out, int32_t(texture.getWidth()));
+        write(out, int32_t(texture.getHeight()));
+        out.write(reinterpret_cast<const char*>(pixels.data()), pixels.size() * sizeof(uint32_t));
+    }
+
+    for (const auto& [name, obj] : objects) {
+        write(out, name);
+        writeObject(out, obj, table);
+
+        write(out, uint32_t(obj.lods.size()));
+        for (const Object& lod : obj.lods) writeObject(out, lod, table);
+    }
+
+    out.close();
+    std::error_code error;
+    if (out.fail()) {
+        std::cerr << "Failed to write mesh cache: " << path << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return;
+    }
+    std::filesystem::rename(tempPath, path, error);
+}
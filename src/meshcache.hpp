@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "material.hpp"
+#include "object.hpp"
+
+/**
+ * A binary cache of the objects and materials parsed from a model folder.
+ *
+ * The cache is stored next to the folder as <folder>.meshcache and holds the
+ * centered and reordered vertex arrays, index buffer, material ranges, bounds and
+ * BVH of every object and of each of its levels of detail, and every material with
+ * its decoded texture pixels. Its header records a hash of the names, sizes and
+ * modification times of the files in the folder and of whether the triangles were
+ * optimized, so the cache is ignored as soon as any of them changes.
+ */
+class MeshCache {
+    private:
+    std::unordered_map<std::string, Object>& objects;
+    std::unordered_map<std::string, Material>& materials;
+    std::string path;
+    uint64_t sourceHash;
+    bool sourcesHashed;  // False if the model folder could not be listed, which disables the cache
+
+    static bool hashSources(const std::string& modelPath, bool optimized, uint64_t& hash);
+    bool read(const char* data, size_t size);
+    void clear();
+
+    public:
+    static constexpr uint32_t VERSION = 5;
+
+    MeshCache(const std::string& modelPath, bool optimized, std::unordered_map<std::string, Object>& objects,
+              std::unordered_map<std::string, Material>& materials);
+
+    bool load();
+    void save() const;
+};
@@ -2,15 +2,61 @@
 #include <string>
 #include <vector>
 
+#include "bounds.hpp"
+#include "bvh.hpp"
 #include "linalg.hpp"
+#include "material.hpp"
 #include "triangle.hpp"
+#include "vertexarray.hpp"
+
+/**
+ * A run of consecutive triangles of an Object drawn with the same material.
+ */
+struct MaterialRange {
+    uint32_t first, count;
+    const Material* material;
+};
 
 struct Object {
     std::string name;
-    std::vector<Vector<float, 3>> vertices;
+    VertexArray<3> vertices;
     std::vector<Vector<float, 2>> textures;
-    std::vector<Vector<float, 3>> normals;
-    std::vector<Vector<float, 3>> modelVertices;
-    std::vector<Vector<float, 3>> modelNormals;
-    std::vector<std::unique_ptr<Triangle>> triangles;
-};
\ No newline at end of file
+    VertexArray<3> normals;
+    VertexArray<3> modelVertices;
+    VertexArray<3> modelNormals;
+    std::vector<uint8_t> clipCodes;
+    // How many entries of the arrays above hold the transformed vertices, normals and clip
+    // codes of the instances drawn in the current frame, each instance in its own part
+    size_t drawnVertexCount = 0;
+    Bounds bounds;
+    BVH bvh;
+
+    // Flat index buffer with three entries per triangle. Each entry names one vertex,
+    // whose position, texture coordinate and normal share that index.
+    std::vector<uint32_t> indices;
+    std::vector<MaterialRange> materialRanges;
+
+    // Simplified versions of this Object, each with about half the triangles of the one before.
+    // error estimates how far, in model space, simplification moved the surface of this version.
+    std::vector<Object> lods;
+    float error = 0;
+
+    uint32_t triangleCount() const { return indices.size() / 3; }
+
+    /**
+     * Appends a triangle, extending the last material range if it uses the same material.
+     */
+    void addTriangle(const uint32_t idx[3], const Material& material) {
+        if (materialRanges.empty() || materialRanges.back().material != &material) {
+            materialRanges.push_back(MaterialRange{triangleCount(), 0, &material});
+        }
+        materialRanges.back().count++;
+
+        indices.insert(indices.end(), idx, idx + 3);
+    }
+
+    void clearTriangles() {
+        indices.clear();
+        materialRanges.clear();
+    }
+};
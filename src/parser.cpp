@@ -1,12 +1,13 @@
 #include "parser.hpp"
 
-#include <SDL2/SDL_image.h>
-
 #include <algorithm>
-#include <cctype>
+#include <array>
+#include <charconv>
 #include <filesystem>
-#include <fstream>
-#include <sstream>
+#include <omp.h>
+
+#include "mappedfile.hpp"
+#include "texturecache.hpp"
 
 void Parser::parse(const std::string& modelPath) {
     std::vector<std::string> matFiles = findFilesOfType(modelPath, ".mtl");
@@ -28,154 +29,388 @@ std::vector<std::string> Parser::findFilesOfType(const std::string& folderPath,
     return files;
 }
 
+/**
+ * Returns whether c separates tokens within a line.
+ */
+static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+/**
+ * Removes the next whitespace-separated token from the front of a line and returns it.
+ * The returned view points into the line, so no memory is allocated.
+ */
+static std::string_view nextToken(std::string_view& line) {
+    size_t start = 0;
+    while (start < line.size() && isSpace(line[start])) start++;
+    size_t end = start;
+    while (end < line.size() && !isSpace(line[end])) end++;
+
+    std::string_view token = line.substr(start, end - start);
+    line.remove_prefix(end);
+    return token;
+}
+
+/**
+ * Removes the next line from the front of a text and returns it, without the newline.
+ */
+static std::string_view nextLine(std::string_view& text) {
+    size_t end = text.find('\n');
+    std::string_view line = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    return line;
+}
+
+/**
+ * Parses a float, returning 0 if the token is not a number.
+ */
+static float parseFloat(std::string_view token) {
+    if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+    float value = 0;
+    std::from_chars(token.data(), token.data() + token.size(), value);
+    return value;
+}
+
+/**
+ * Parses one index of a face corner, returning 0 if it is missing.
+ */
+static long parseIndex(std::string_view token) {
+    long value = 0;
+    std::from_chars(token.data(), token.data() + token.size(), value);
+    return value;
+}
+
+/**
+ * Resolves a 1-based OBJ index, where negative indices count back from the
+ * last element, to an index into an array that keeps a placeholder at 0.
+ * Missing or out of range indices resolve to the placeholder.
+ */
+static uint32_t resolveIndex(long index, size_t size) {
+    if (index < 0) index += size;
+    return index > 0 && size_t(index) < size ? index : 0;
+}
+
+template <size_t N>
+Vector<float, N> Parser::readLine(std::string_view& line) {
+    Vector<float, N> result;
+    for (size_t i = 0; i < N; ++i) result[i] = parseFloat(nextToken(line));
+    return result;
+}
+
+/**
+ * @brief Parses an MTL or OBJ file.
+ *
+ * The file is memory-mapped and split into lines in place, and every line is
+ * tokenized without copying it, so the cost of parsing is dominated by the
+ * number conversions rather than by allocations.
+ *
+ * @param path The path of the file to parse.
+ */
 void Parser::parseFile(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) throw std::runtime_error("Failed to open MTL file: " + std::string(path));
+    MappedFile file(path);
 
-    std::string folderPath = path.substr(0, path.find_last_of('/'));
+    folderPath = path.substr(0, path.find_last_of('/'));
     std::string fileType = path.substr(path.find_last_of('.'));
-    std::string line, currObj, currMtl;
+    currObj = nullptr;
+    currMtl = nullptr;
 
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        if (fileType == ".mtl") parseMTLLine(ss, folderPath, currMtl);
-        if (fileType == ".obj") parseOBJLine(ss, currObj, currMtl);
+    if (fileType == ".mtl") {
+        for (std::string_view text = file.view(); !text.empty();) parseMTLLine(nextLine(text));
     }
 
-    if (fileType == ".obj") {
-        objects[currObj].modelVertices = objects[currObj].vertices;
-        objects[currObj].modelNormals = objects[currObj].normals;
+    if (fileType == ".obj") parseOBJ(file.view());
+}
+
+/**
+ * @brief Parses the contents of an OBJ file in parallel.
+ *
+ * The text is split into newline-aligned chunks, one per thread, which are
+ * tokenized independently into their own buffers. The chunks are then merged
+ * in file order, which resolves face indices against the objects and
+ * materials the preceding chunks left behind.
+ *
+ * @param text The contents of the OBJ file.
+ */
+void Parser::parseOBJ(std::string_view text) {
+    const size_t chunkCount = std::clamp<size_t>(text.size() / MIN_CHUNK_SIZE, 1, omp_get_max_threads());
+
+    std::vector<std::string_view> ranges;
+    for (size_t i = 0, start = 0; i < chunkCount; i++) {
+        size_t end = i + 1 == chunkCount ? text.size() : std::max(start, text.size() * (i + 1) / chunkCount);
+        end = std::min(text.find('\n', end), text.size());
+        ranges.push_back(text.substr(start, end - start));
+        start = std::min(end + 1, text.size());
     }
 
-    file.close();
+    std::vector<OBJChunk> chunks(ranges.size());
+    #pragma omp parallel for schedule(static, 1)
+    for (size_t i = 0; i < ranges.size(); i++) parseOBJChunk(ranges[i], chunks[i]);
+
+    for (const OBJChunk& chunk : chunks) mergeOBJChunk(chunk);
+
+    if (currObj) finishObject(*currObj);
+}
+
+/**
+ * Starts a new, empty object and makes it the current one. Index 0 of the
+ * vertex, texture and normal arrays holds a placeholder for missing indices.
+ */
+void Parser::beginObject(const std::string& name) {
+    currObj = &(objects[name] = Object{name});
+    currObj->vertices.push_back(Vector<float, 3>{0, 0, 0});
+    currObj->textures.push_back(Vector<float, 2>{0, 0});
+    currObj->normals.push_back(Vector<float, 3>{0, 0, 0});
+
+    cornerVertices.clear();
+    cornerTextures.clear();
+    cornerNormals.clear();
+}
+
+/**
+ * Called once all lines of an object have been read. Welds its corners into
+ * vertices, keeps a copy of the welded vertices and normals as the object's
+ * model-space data and computes its bounding volumes.
+ */
+void Parser::finishObject(Object& obj) {
+    weldObject(obj);
+    obj.modelVertices = obj.vertices;
+    obj.modelNormals = obj.normals;
+    obj.bounds = Bounds::fromPoints(obj.modelVertices);
+}
+
+/**
+ * Returns the material with the given name, adding an untextured one if it does not exist yet.
+ */
+Material& Parser::getMaterial(const std::string& name) {
+    auto it = materials.find(name);
+    if (it != materials.end()) return it->second;
+
+    return materials[name] = Material{name};
 }
 
-void Parser::parseMTLLine(std::stringstream& ss, std::string& folderPath, std::string& currMtl) {
-    std::string prefix;
-    ss >> prefix;
+void Parser::parseMTLLine(std::string_view line) {
+    std::string_view prefix = nextToken(line);
     if (prefix.empty() || prefix == "#") return;
 
     if (prefix == "newmtl") {
-        ss >> currMtl;
-        materials[currMtl] = Material{currMtl};
+        std::string name(nextToken(line));
+        currMtl = &(materials[name] = Material{name});
     }
 
-    if (currMtl.empty()) {
-        currMtl = "default";
-        materials[currMtl] = Material{currMtl};
-    }
+    if (!currMtl) currMtl = &(materials["default"] = Material{"default"});
 
     if (prefix == "Ka")
-        materials[currMtl].ambient = readLine<3>(ss);
+        currMtl->ambient = readLine<3>(line);
     else if (prefix == "Kd")
-        materials[currMtl].diffuse = readLine<3>(ss);
+        currMtl->diffuse = readLine<3>(line);
     else if (prefix == "Ks")
-        materials[currMtl].specular = readLine<3>(ss);
+        currMtl->specular = readLine<3>(line);
     else if (prefix == "Ns")
-        ss >> materials[currMtl].shininess;
+        currMtl->shininess = parseFloat(nextToken(line));
     else if (prefix == "map_Kd") {
-        ss >> materials[currMtl].texturePath;
-        materials[currMtl].texturePath = folderPath + "/" + materials[currMtl].texturePath;
-        materials[currMtl].image = IMG_Load(materials[currMtl].texturePath.c_str());
-
-        if (!materials[currMtl].image)
-            std::cerr << "Failed to load image: " << IMG_GetError() << std::endl;
+        currMtl->texturePath = folderPath + "/" + std::string(nextToken(line));
+        currMtl->texture = TextureCache::getInstance().get(currMtl->texturePath);
     }
 }
 
-void Parser::parseOBJLine(std::stringstream& ss, std::string& currObj, std::string& currMtl) {
-    std::string prefix;
-    ss >> prefix;
-    if (prefix.empty() || prefix == "#" || prefix == "mtllib") return;
-
-    if (prefix == "o") {
-        if (!currObj.empty()) {
-            objects[currObj].modelVertices = objects[currObj].vertices;
-            objects[currObj].modelNormals = objects[currObj].normals;
+/**
+ * @brief Tokenizes one chunk of an OBJ file.
+ *
+ * Only reads the text and writes to the chunk, so chunks can be parsed concurrently.
+ *
+ * @param text The lines of the chunk.
+ * @param chunk The chunk to write the vertex data, faces and material changes to.
+ */
+void Parser::parseOBJChunk(std::string_view text, OBJChunk& chunk) const {
+    OBJSegment* segment = &chunk.segments.emplace_back();
+    int32_t material = -1;
+
+    while (!text.empty()) {
+        std::string_view line = nextLine(text);
+        std::string_view prefix = nextToken(line);
+        if (prefix.empty() || prefix == "#" || prefix == "mtllib") continue;
+
+        if (prefix == "o") {
+            segment = &chunk.segments.emplace_back();
+            segment->name = nextToken(line);
+            if (segment->name.empty()) segment->name = "default";
+            segment->continued = false;
         }
 
-        ss >> currObj;
-        objects[currObj] = Object{currObj};
+        segment->hasLines = true;
+
+        if (prefix == "usemtl") {
+            chunk.materials.emplace_back(nextToken(line));
+            material = chunk.materials.size() - 1;
+        }
 
-        objects[currObj].vertices.push_back(Vector<float, 3>{0, 0, 0});
-        objects[currObj].textures.push_back(Vector<float, 2>{0, 0});
-        objects[currObj].normals.push_back(Vector<float, 3>{0, 0, 0});
+        if (material < 0) chunk.linesBeforeMaterial = true;
+
+        if (prefix == "v")
+            segment->vertices.push_back(readLine<3>(line));
+        else if (prefix == "vt")
+            segment->textures.push_back(readLine<2>(line));
+        else if (prefix == "vn")
+            segment->normals.push_back(readLine<3>(line));
+        else if (prefix == "f") {
+            // Each corner is v, v/vt, v//vn or v/vt/vn
+            OBJFace face = {uint32_t(segment->corners.size()), 0, uint32_t(segment->vertices.size()),
+                            uint32_t(segment->textures.size()), uint32_t(segment->normals.size()), material};
+            for (std::string_view corner = nextToken(line); !corner.empty(); corner = nextToken(line)) {
+                std::string_view indices[3];
+                for (size_t i = 0; i < 3 && !corner.empty(); i++) {
+                    size_t slash = corner.find('/');
+                    indices[i] = corner.substr(0, slash);
+                    corner.remove_prefix(slash == std::string_view::npos ? corner.size() : slash + 1);
+                }
+                for (size_t i = 0; i < 3; i++) segment->corners.push_back(parseIndex(indices[i]));
+                face.cornerCount++;
+            }
+
+            if (face.cornerCount >= 3) {
+                segment->faces.push_back(face);
+            } else {
+                segment->corners.resize(face.firstCorner);
+            }
+        }
     }
+}
 
-    if (currObj.empty()) {
-        currObj = "default";
-        objects[currObj] = Object{currObj};
+/**
+ * @brief Appends a parsed chunk to the objects and materials.
+ *
+ * Segments continue or start objects just like the lines they were read from
+ * would have, and every face is resolved against the sizes its object's arrays
+ * had when it was read, so the result does not depend on how the file was split.
+ *
+ * @param chunk The chunk to merge. Chunks must be merged in file order.
+ */
+void Parser::mergeOBJChunk(const OBJChunk& chunk) {
+    if (chunk.linesBeforeMaterial && !currMtl) currMtl = &getMaterial("");
+    Material* startMtl = currMtl;
+
+    std::vector<Material*> chunkMaterials;
+    for (const std::string& name : chunk.materials) chunkMaterials.push_back(&getMaterial(name));
+    if (!chunkMaterials.empty()) currMtl = chunkMaterials.back();
+
+    for (const OBJSegment& segment : chunk.segments) {
+        if (!segment.continued) {
+            if (currObj) finishObject(*currObj);
+            beginObject(segment.name);
+        } else if (!currObj) {
+            if (!segment.hasLines) continue;
+            beginObject("default");
+        }
 
-        objects[currObj].vertices.push_back(Vector<float, 3>{0, 0, 0});
-        objects[currObj].textures.push_back(Vector<float, 2>{0, 0});
-        objects[currObj].normals.push_back(Vector<float, 3>{0, 0, 0});
+        Object& obj = *currObj;
+        const size_t vertexBase = obj.vertices.size();
+        const size_t textureBase = obj.textures.size();
+        const size_t normalBase = obj.normals.size();
+        for (const auto& vertex : segment.vertices) obj.vertices.push_back(vertex);
+        obj.textures.insert(obj.textures.end(), segment.textures.begin(), segment.textures.end());
+        for (const auto& normal : segment.normals) obj.normals.push_back(normal);
+
+        for (const OBJFace& face : segment.faces) {
+            Material& material = face.material < 0 ? *startMtl : *chunkMaterials[face.material];
+            addFace(obj, material, &segment.corners[face.firstCorner], face.cornerCount, vertexBase + face.vertices,
+                    textureBase + face.textures, normalBase + face.normals);
+        }
     }
+}
 
-    if (prefix == "v")
-        objects[currObj].vertices.push_back(readLine<3>(ss));
-    else if (prefix == "vt")
-        objects[currObj].textures.push_back(readLine<2>(ss));
-    else if (prefix == "vn")
-        objects[currObj].normals.push_back(readLine<3>(ss));
-    else if (prefix == "usemtl")
-        ss >> currMtl;
-
-    if (materials.find(currMtl) == materials.end()) {
-        materials[currMtl] = Material{currMtl};
-        materials[currMtl].image = nullptr;
+/**
+ * @brief Resolves the corners of a face and fans it into triangles.
+ *
+ * The triangles' corners are recorded unwelded, and the object's index buffer
+ * refers to them by position until weldObject replaces the indices.
+ *
+ * @param obj The object the face belongs to.
+ * @param material The material of the face.
+ * @param corners The v, vt and vn index of each corner, as written in the file.
+ * @param cornerCount The number of corners, at least 3.
+ * @param vertexCount The size of the object's vertex array when the face was read.
+ * @param textureCount The size of the object's texture array when the face was read.
+ * @param normalCount The size of the object's normal array when the face was read.
+ */
+void Parser::addFace(Object& obj, Material& material, const long* corners, size_t cornerCount, size_t vertexCount,
+                     size_t textureCount, size_t normalCount) {
+    auto addCorner = [&](size_t i) {
+        cornerVertices.push_back(resolveIndex(corners[3 * i], vertexCount));
+        cornerTextures.push_back(resolveIndex(corners[3 * i + 1], textureCount));
+        cornerNormals.push_back(resolveIndex(corners[3 * i + 2], normalCount));
+    };
+
+    for (size_t i = 1; i + 1 < cornerCount; i++) {
+        const uint32_t first = cornerVertices.size();
+        addCorner(0);
+        addCorner(i);
+        addCorner(i + 1);
+
+        uint32_t idx[] = {first, first + 1, first + 2};
+        obj.addTriangle(idx, material);
     }
-
-    if (prefix == "f") parseFace(ss, currObj, currMtl);
 }
 
-void Parser::parseFace(std::stringstream& ss, std::string& objName, std::string& mtlName) {
-    std::vector<uint32_t> vi, vti, vni;
-    std::string vertexData;
-
-    // Use references to avoid copying vectors
-    auto& vertices = objects[objName].vertices;
-    auto& textures = objects[objName].textures;
-    auto& normals = objects[objName].normals;
-    auto& triangles = objects[objName].triangles;
-
-    while (ss >> vertexData) {
-        std::stringstream vs(vertexData);
-        std::string v, vt, vn;
-        std::getline(vs, v, '/');   // vertex index
-        std::getline(vs, vt, '/');  // texture index (may be empty)
-        std::getline(vs, vn, '/');  // normal index (may be empty)
-
-        // Convert to index, handling empty values
-        size_t vidx = v.empty() ? 0 : std::stoi(v);
-        size_t vtidx = (vt.empty() || vt == " ") ? 0 : std::stoi(vt);
-        size_t vnidx = vn.empty() ? 0 : std::stoi(vn);
-
-        // Handle negative indexing
-        if (vidx < 0) vidx += vertices.size();
-        if (!vt.empty() && vtidx < 0) vtidx += textures.size();
-        if (!vn.empty() && vnidx < 0) vnidx += normals.size();
-
-        // Adjust for 0-based indexing and check validity
-        vi.push_back(vidx > 0 && vidx <= vertices.size() ? vidx : 0);
-        vti.push_back(vtidx > 0 && vtidx <= textures.size() ? vtidx : 0);
-        vni.push_back(vnidx > 0 && vnidx <= normals.size() ? vnidx : 0);
+/**
+ * Hashes the v, vt and vn index of a corner.
+ */
+struct CornerHash {
+    size_t operator()(const std::array<uint32_t, 3>& corner) const {
+        return (uint64_t(corner[0]) * 73856093) ^ (uint64_t(corner[1]) * 19349663) ^ (uint64_t(corner[2]) * 83492791);
     }
-
-    if (vni[0] == 0) {
-        size_t newNormalIdx = normals.size();
-        normals.push_back((vertices[vi[1]] - vertices[vi[0]]).cross(vertices[vi[2]] - vertices[vi[0]]).normalize());
-
-        for (uint32_t i = 0; i < vi.size(); i++) {
-            if (vni[i] == 0) vni[i] = newNormalIdx;
+};
+
+/**
+ * @brief Welds the corners of an object into shared vertices.
+ *
+ * Every distinct combination of position, texture coordinate and normal becomes
+ * one vertex, numbered in the order the triangles first use it, and the index
+ * buffer is rewritten to refer to the welded vertices. Corners without a normal
+ * get a smooth one instead: the area-weighted average of the normals of all
+ * triangles sharing their position. Afterwards the vertex, texture and normal
+ * arrays all have one entry per vertex, with the placeholder still at index 0.
+ *
+ * @param obj The object to weld. Its index buffer must refer to the recorded corners.
+ */
+void Parser::weldObject(Object& obj) {
+    const size_t cornerCount = cornerVertices.size();
+
+    std::vector<Vector<float, 3>> smoothNormals;
+    if (std::find(cornerNormals.begin(), cornerNormals.end(), 0) != cornerNormals.end()) {
+        smoothNormals.assign(obj.vertices.size(), Vector<float, 3>{0, 0, 0});
+        for (size_t c = 0; c < cornerCount; c += 3) {
+            Vector<float, 3> v0 = obj.vertices[cornerVertices[c]];
+            Vector<float, 3> faceNormal =
+                (obj.vertices[cornerVertices[c + 1]] - v0).cross(obj.vertices[cornerVertices[c + 2]] - v0);
+            for (size_t i = c; i < c + 3; i++) smoothNormals[cornerVertices[i]] = smoothNormals[cornerVertices[i]] + faceNormal;
+        }
+        for (auto& normal : smoothNormals) {
+            if (normal.norm() > 0) normal = normal.normalize();
         }
     }
 
-    // Create triangles
-    for (uint32_t i = 1; i < vi.size() - 1; i++) {
-        uint32_t vidx[] = {vi[0], vi[i], vi[i + 1]};
-        uint32_t uvidx[] = {vti[0], vti[i], vti[i + 1]};
-        uint32_t nidx[] = {vni[0], vni[i], vni[i + 1]};
-        
-        triangles.push_back(std::make_unique<Triangle>(vidx, uvidx, nidx, materials[mtlName], objects[objName]));
+    VertexArray<3> vertices, normals;
+    std::vector<Vector<float, 2>> textures;
+    vertices.push_back(obj.vertices[0]);
+    textures.push_back(obj.textures[0]);
+    normals.push_back(obj.normals[0]);
+
+    std::unordered_map<std::array<uint32_t, 3>, uint32_t, CornerHash> welded;
+    welded.reserve(cornerCount);
+    for (uint32_t& index : obj.indices) {
+        const std::array<uint32_t, 3> corner = {cornerVertices[index], cornerTextures[index], cornerNormals[index]};
+        auto [it, inserted] = welded.emplace(corner, vertices.size());
+        index = it->second;
+        if (!inserted) continue;
+
+        vertices.push_back(obj.vertices[corner[0]]);
+        textures.push_back(obj.textures[corner[1]]);
+        normals.push_back(corner[2] ? obj.normals[corner[2]] : smoothNormals[corner[0]]);
     }
+
+    obj.vertices = std::move(vertices);
+    obj.textures = std::move(textures);
+    obj.normals = std::move(normals);
+
+    cornerVertices.clear();
+    cornerTextures.clear();
+    cornerNormals.clear();
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -9,23 +10,73 @@
 
 class Parser {
     private:
+    /**
+     * A face of an OBJ chunk with its corner indices still unresolved. The counts of
+     * vertices, texture coordinates and normals of its segment parsed before it are
+     * kept, so that it can be resolved exactly as if the file had been read in order.
+     */
+    struct OBJFace {
+        uint32_t firstCorner, cornerCount;
+        uint32_t vertices, textures, normals;
+        int32_t material;  // Index into OBJChunk::materials, or -1 for the material current at the chunk's start
+    };
+
+    /**
+     * The lines of an OBJ chunk belonging to one object. The first segment of a
+     * chunk continues the object of the previous chunk, every other one starts
+     * at an 'o' line.
+     */
+    struct OBJSegment {
+        std::string name;
+        bool continued = true;
+        bool hasLines = false;
+        std::vector<Vector<float, 3>> vertices;
+        std::vector<Vector<float, 2>> textures;
+        std::vector<Vector<float, 3>> normals;
+        std::vector<OBJFace> faces;
+        std::vector<long> corners;  // The v, vt and vn index of each face corner, 0 if missing
+    };
+
+    /**
+     * The result of parsing one newline-aligned chunk of an OBJ file on its own.
+     */
+    struct OBJChunk {
+        std::vector<OBJSegment> segments;
+        std::vector<std::string> materials;  // The names of its usemtl lines, in order
+        bool linesBeforeMaterial = false;
+    };
+
     std::unordered_map<std::string, Object>& objects;
     std::unordered_map<std::string, Material>& materials;
 
+    // Files smaller than this are parsed on one thread
+    static constexpr size_t MIN_CHUNK_SIZE = 1 << 18;
+
+    // State of the file currently being parsed. Map entries never move, so pointers stay valid.
+    std::string folderPath;
+    Object* currObj = nullptr;
+    Material* currMtl = nullptr;
+
+    // The v, vt and vn index of each triangle corner of the current object, until it is welded
+    std::vector<uint32_t> cornerVertices, cornerTextures, cornerNormals;
+
     template <size_t N>
-    Vector<float, N> readLine(std::stringstream& ss) {
-        Vector<float, N> result;
-        for (size_t i = 0; i < N; ++i) ss >> result[i];
-        return result;
-    }
+    static Vector<float, N> readLine(std::string_view& line);
 
     std::vector<std::string> findFilesOfType(const std::string& folderPath, const std::string& fileType);
     void parseFile(const std::string& path);
-    void parseMTLLine(std::stringstream& ss, std::string& folderPath, std::string& currMtl);
-    void parseOBJLine(std::stringstream& ss, std::string& currObj, std::string& currMtl);
-    void parseFace(std::stringstream& ss, std::string& currObj, std::string& currMtl);
+    void beginObject(const std::string& name);
+    void finishObject(Object& obj);
+    Material& getMaterial(const std::string& name);
+    void parseMTLLine(std::string_view line);
+    void parseOBJ(std::string_view text);
+    void parseOBJChunk(std::string_view text, OBJChunk& chunk) const;
+    void mergeOBJChunk(const OBJChunk& chunk);
+    void addFace(Object& obj, Material& material, const long* corners, size_t cornerCount, size_t vertexCount,
+                 size_t textureCount, size_t normalCount);
+    void weldObject(Object& obj);
 
     public:
     Parser(std::unordered_map<std::string, Object>& objects, std::unordered_map<std::string, Material>& materials) : objects(objects), materials(materials) {};
     void parse(const std::string& modelPath);
-};
\ No newline at end of file
+};
@@ -0,0 +1,83 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+static const char* STAGE_NAMES[STAGE_COUNT] = {
+    "vertex_transform",
+    "normal_transform",
+    "cull",
+    "binning",
+    "rasterization",
+    "shading",
+    "present",
+};
+
+/**
+ * Returns the value at the given percentile (0 to 1) of an already sorted list.
+ */
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = std::ceil(p * sorted.size());
+    return sorted[std::clamp<size_t>(index, 1, sorted.size()) - 1];
+}
+
+static void writeStats(std::ostream& out, std::vector<double> times) {
+    std::sort(times.begin(), times.end());
+    double mean = times.empty() ? 0 : std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+    out << "{\"min\": " << (times.empty() ? 0 : times.front())
+        << ", \"median\": " << percentile(times, 0.5)
+        << ", \"p99\": " << percentile(times, 0.99)
+        << ", \"max\": " << (times.empty() ? 0 : times.back())
+        << ", \"mean\": " << mean << "}";
+}
+
+Profiler& Profiler::getInstance() {
+    static Profiler instance;
+    return instance;
+}
+
+void Profiler::beginFrame() {
+    stageTimes.fill(0);
+    frameStart = now();
+}
+
+void Profiler::endFrame() {
+    if (!enabled) return;
+    frameHistory.push_back(elapsed(frameStart));
+    stageHistory.push_back(stageTimes);
+}
+
+/**
+ * Discards all recorded frames, e.g. after warming up caches.
+ */
+void Profiler::reset() {
+    frameHistory.clear();
+    stageHistory.clear();
+    stageRecorded.fill(false);
+}
+
+/**
+ * Writes the frame time statistics and the per-stage breakdown, in milliseconds, as JSON.
+ * Only the stages recorded since the last reset are listed.
+ */
+void Profiler::writeJSON(std::ostream& out) {
+    out << "{\n  \"config\": {";
+    for (size_t i = 0; i < config.size(); i++) out << (i ? ", " : "") << "\"" << config[i].first << "\": \"" << config[i].second << "\"";
+    out << "},\n  \"frames\": " << frameHistory.size() << ",\n  \"frame_ms\": ";
+    writeStats(out, frameHistory);
+    out << ",\n  \"stages_ms\": {";
+
+    bool first = true;
+    for (size_t stage = 0; stage < STAGE_COUNT; stage++) {
+        if (!stageRecorded[stage]) continue;
+        std::vector<double> times;
+        for (const auto& frame : stageHistory) times.push_back(frame[stage]);
+
+        out << (first ? "\n" : ",\n") << "    \"" << STAGE_NAMES[stage] << "\": ";
+        writeStats(out, times);
+        first = false;
+    }
+    out << "\n  }\n}" << std::endl;
+}
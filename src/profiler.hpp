@@ -0,0 +1,62 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+
+#include <array>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum Stage {
+    VERTEX_TRANSFORM,
+    NORMAL_TRANSFORM,
+    CULL,
+    BINNING,
+    RASTERIZATION,
+    SHADING,
+    PRESENT,
+    STAGE_COUNT
+};
+
+/**
+ * Collects per-frame wall clock times, split by pipeline stage.
+ * Recording is a no-op until the profiler is enabled, so the render loop can be
+ * instrumented unconditionally. Stages that never ran, such as presenting in a
+ * headless run, are left out of the results.
+ */
+class Profiler {
+   private:
+    bool enabled = false;
+    uint64_t frameStart = 0;
+    std::array<double, STAGE_COUNT> stageTimes{};
+    std::array<bool, STAGE_COUNT> stageRecorded{};
+    std::vector<std::array<double, STAGE_COUNT>> stageHistory;
+    std::vector<double> frameHistory;
+    // The settings the frames were rendered with, so that results can be told apart
+    std::vector<std::pair<std::string, std::string>> config;
+
+    Profiler() = default;
+    double elapsed(uint64_t start) { return double(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency(); }
+
+   public:
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+    static Profiler& getInstance();
+
+    bool isEnabled() { return enabled; }
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+
+    uint64_t now() { return enabled ? SDL_GetPerformanceCounter() : 0; }
+    void record(Stage stage, uint64_t start) {
+        if (!enabled) return;
+        stageTimes[stage] += elapsed(start);
+        stageRecorded[stage] = true;
+    }
+    void setConfig(const std::string& key, const std::string& value) { config.emplace_back(key, value); }
+
+    void beginFrame();
+    void endFrame();
+    void reset();
+    void writeJSON(std::ostream& out);
+};
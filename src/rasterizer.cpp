@@ -0,0 +1,112 @@
+#include "rasterizer.hpp"
+
+/**
+ * @brief Splits the window into a grid of TILE_SIZE x TILE_SIZE tiles.
+ *
+ * Tiles on the right and bottom edges are cropped to the window. The visibility
+ * buffer covers the whole window and starts out empty.
+ */
+Rasterizer::Rasterizer() : window(Window::getInstance()), visibility(window.getWidth() * window.getHeight()) {
+    cols = (window.getWidth() + TILE_SIZE - 1) / TILE_SIZE;
+    rows = (window.getHeight() + TILE_SIZE - 1) / TILE_SIZE;
+
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            Rect bounds = {col * TILE_SIZE, row * TILE_SIZE,
+                           std::min((col + 1) * TILE_SIZE, window.getWidth()) - 1,
+                           std::min((row + 1) * TILE_SIZE, window.getHeight()) - 1};
+            tiles.push_back(Tile{bounds});
+        }
+    }
+}
+
+Rasterizer& Rasterizer::getInstance() {
+    static Rasterizer instance;
+    return instance;
+}
+
+/**
+ * @brief Adds a triangle to every tile its screen-space bounding box overlaps.
+ *
+ * The triangle is copied, and the tiles only store its index among the binned
+ * triangles. Its Object's vertices must already be in device coordinates and
+ * must stay valid until the next call to resolve().
+ *
+ * @param triangle The triangle to rasterize on the next flush.
+ */
+void Rasterizer::bin(const Triangle& triangle) {
+    Rect bounds = triangle.getBounds();
+    if (bounds.empty()) return;
+
+    const uint32_t index = triangles.size();
+    triangles.push_back(triangle);
+
+    for (int row = bounds.y0 / TILE_SIZE; row <= bounds.y1 / TILE_SIZE; row++) {
+        for (int col = bounds.x0 / TILE_SIZE; col <= bounds.x1 / TILE_SIZE; col++) {
+            tiles[row * cols + col].triangles.push_back(index);
+        }
+    }
+}
+
+/**
+ * @brief Rasterizes every binned triangle.
+ *
+ * Called once per frame, after every Mesh has binned its triangles.
+ * Each tile is owned by a single thread, which fills its triangles in submission
+ * order. Since no two tiles share a pixel, the depth, color and visibility buffers
+ * need no synchronization and the result is identical to a single-threaded pass.
+ * With deferred shading only depth and visibility are written, and colors are
+ * left to resolve().
+ */
+void Rasterizer::flush() {
+    Fragment* fragments = shadingMode == DEFERRED ? visibility.data() : nullptr;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < tiles.size(); i++) {
+        for (uint32_t index : tiles[i].triangles) {
+            if (fillMode == HALF_SPACE)
+                triangles[index].fillHalfSpace(tiles[i].bounds, fragments, index);
+            else
+                triangles[index].fill(tiles[i].bounds, fragments, index);
+        }
+    }
+}
+
+/**
+ * @brief Shades the pixels of a tile that are left in the visibility buffer and
+ * empties them again.
+ *
+ * @param bounds The tile to shade.
+ */
+void Rasterizer::shadeTile(const Rect& bounds) {
+    const int width = window.getWidth();
+    float* depth_buffer = window.getDepthBuffer()->data();
+    uint32_t* color_buffer = window.getColorBuffer()->data();
+
+    for (int y = bounds.y0; y <= bounds.y1; y++) {
+        for (int x = bounds.x0; x <= bounds.x1; x++) {
+            const int bufferIndex = x + y * width;
+            Fragment& fragment = visibility[bufferIndex];
+            if (fragment.triangle == NO_TRIANGLE) continue;
+
+            color_buffer[bufferIndex] = triangles[fragment.triangle].shade(x, y, depth_buffer[bufferIndex], fragment);
+            fragment.triangle = NO_TRIANGLE;
+        }
+    }
+}
+
+/**
+ * @brief Finishes the pixels of the last flush() and empties the bins.
+ *
+ * With deferred shading, every tile that had triangles binned to it is shaded,
+ * in parallel, with each visible pixel shaded exactly once. The cost of shading
+ * then depends on the number of pixels covered instead of the overdraw.
+ */
+void Rasterizer::resolve() {
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < tiles.size(); i++) {
+        if (shadingMode == DEFERRED && !tiles[i].triangles.empty()) shadeTile(tiles[i].bounds);
+        tiles[i].triangles.clear();
+    }
+    triangles.clear();
+}
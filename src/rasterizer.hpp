@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "triangle.hpp"
+#include "window.hpp"
+
+#define TILE_SIZE 64
+
+enum FillMode {
+    SCANLINE,
+    HALF_SPACE
+};
+
+/**
+ * When pixels are shaded. FORWARD shades every pixel that passes the depth test as
+ * its triangle is rasterized, so overdrawn pixels are shaded more than once.
+ * DEFERRED rasterizes into a visibility buffer first and shades each visible pixel
+ * once afterwards.
+ */
+enum ShadingMode {
+    FORWARD,
+    DEFERRED
+};
+
+/**
+ * Which triangles are dropped by their winding on screen. Front faces appear
+ * counterclockwise, which gives them a negative area in y-down screen coordinates.
+ */
+enum CullMode {
+    CULL_BACK,
+    CULL_FRONT,
+    CULL_NONE
+};
+
+/**
+ * Returns whether a cull mode drops a triangle, given twice its signed screen-space
+ * area, which is negative for front faces. Triangles without area are always dropped.
+ */
+inline bool isCulled(float twiceArea, CullMode mode) {
+    if (mode == CULL_BACK) return !(twiceArea < 0);
+    if (mode == CULL_FRONT) return !(twiceArea > 0);
+    return !(std::fabs(twiceArea) > 0);
+}
+
+/**
+ * A square region of the screen together with the triangles that overlap it,
+ * in the order they were submitted.
+ */
+struct Tile {
+    Rect bounds;
+    std::vector<uint32_t> triangles;
+};
+
+class Rasterizer {
+   private:
+    Window& window;
+    int cols, rows;
+    std::vector<Tile> tiles;
+    std::vector<Triangle> triangles;
+    std::vector<Fragment> visibility;
+    FillMode fillMode = HALF_SPACE;
+    CullMode cullMode = CULL_BACK;
+    ShadingMode shadingMode = FORWARD;
+
+    Rasterizer();
+    void shadeTile(const Rect& bounds);
+
+   public:
+    Rasterizer(const Rasterizer&) = delete;
+    Rasterizer& operator=(const Rasterizer&) = delete;
+    static Rasterizer& getInstance();
+
+    FillMode getFillMode() { return fillMode; }
+    void setFillMode(FillMode fillMode) { this->fillMode = fillMode; }
+    CullMode getCullMode() { return cullMode; }
+    void setCullMode(CullMode cullMode) { this->cullMode = cullMode; }
+    ShadingMode getShadingMode() { return shadingMode; }
+    void setShadingMode(ShadingMode shadingMode) { this->shadingMode = shadingMode; }
+
+    void bin(const Triangle& triangle);
+    void flush();
+    void resolve();
+};
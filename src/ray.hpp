@@ -0,0 +1,12 @@
+#pragma once
+
+#include "linalg.hpp"
+
+/**
+ * A ray starting at origin and extending along direction, which does not need to
+ * be normalized. Hit distances are measured in multiples of direction.
+ */
+struct Ray {
+    Vector<float, 3> origin;
+    Vector<float, 3> direction;
+};
@@ -0,0 +1,75 @@
+#include "scenenode.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+SceneNode::~SceneNode() {
+    setParent(nullptr);
+    for (SceneNode* child : children) {
+        child->parent = nullptr;
+        child->dirty = true;
+    }
+}
+
+/**
+ * @brief Attaches the node to a new parent, keeping its local transform.
+ *
+ * @param parent The new parent, or null to make the node a root.
+ * @throws std::runtime_error if the parent is the node itself or one of its descendants.
+ */
+void SceneNode::setParent(SceneNode* parent) {
+    for (SceneNode* node = parent; node; node = node->parent) {
+        if (node == this) throw std::runtime_error("Scene node cannot be its own ancestor");
+    }
+
+    if (this->parent) {
+        std::vector<SceneNode*>& siblings = this->parent->children;
+        siblings.erase(std::find(siblings.begin(), siblings.end(), this));
+    }
+    this->parent = parent;
+    if (parent) parent->children.push_back(this);
+    dirty = true;
+}
+
+/**
+ * Returns the transform from the node's space to its parent's: scale, then
+ * rotation by the Euler angles, then translation.
+ */
+Matrix<float, 4, 4> SceneNode::getLocalTransform() const {
+    Matrix<float, 4, 4> local;
+    local.set_rotation3(rotation);
+    for (size_t r = 0; r < 3; r++) {
+        for (size_t c = 0; c < 3; c++) local[r][c] *= scale[c];
+    }
+    local.set_position(position);
+    return local;
+}
+
+/**
+ * @brief Returns the transform from the node's space to world space.
+ *
+ * The transform is only rebuilt if the node or one of its ancestors changed since
+ * it was last returned.
+ */
+const Matrix<float, 4, 4>& SceneNode::getWorldTransform() {
+    if (parent) {
+        parent->getWorldTransform();
+        if (parentVersion != parent->version) dirty = true;
+    }
+    if (!dirty) return world;
+
+    world = parent ? parent->world * getLocalTransform() : getLocalTransform();
+    if (parent) parentVersion = parent->version;
+    version++;
+    dirty = false;
+    return world;
+}
+
+/**
+ * Returns a number that changes whenever the world transform does, bringing the
+ * world transform up to date first.
+ */
+uint64_t SceneNode::getVersion() {
+    getWorldTransform();
+    return version;
+}
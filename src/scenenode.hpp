@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "linalg.hpp"
+
+/**
+ * A node of the scene graph, placed relative to its parent node if it has one.
+ *
+ * A node's local transform scales, then rotates, then moves it, and its world
+ * transform is its parent's world transform applied after its local one. The world
+ * transform is cached: changing a node only marks it dirty, and it is rebuilt the
+ * next time it is asked for, together with those of its ancestors that changed and
+ * only if one of them did. Nodes that do not move therefore cost no matrix math
+ * from one frame to the next.
+ *
+ * Nodes do not own each other. A node that is destroyed detaches itself from its
+ * parent, and its children become roots.
+ */
+class SceneNode {
+   private:
+    SceneNode* parent = nullptr;
+    std::vector<SceneNode*> children;
+
+    Vector<float, 3> position = {0, 0, 0};
+    Vector<float, 3> rotation = {0, 0, 0};
+    Vector<float, 3> scale = {1, 1, 1};
+
+    Matrix<float, 4, 4> world;
+    bool dirty = true;
+    // Changes whenever the world transform does, so that anything derived from it can tell it is stale
+    uint64_t version = 0;
+    // The version of the parent's world transform this node's was built from
+    uint64_t parentVersion = 0;
+
+   public:
+    SceneNode() = default;
+    SceneNode(const SceneNode&) = delete;
+    SceneNode& operator=(const SceneNode&) = delete;
+    virtual ~SceneNode();
+
+    SceneNode* getParent() { return this->parent; };
+    const std::vector<SceneNode*>& getChildren() { return this->children; };
+    void setParent(SceneNode* parent);
+
+    Vector<float, 3> getPosition() { return this->position; };
+    void setPosition(Vector<float, 3> position) {
+        this->position = position;
+        this->dirty = true;
+    };
+    Vector<float, 3> getRotation() { return this->rotation; };
+    void setRotation(Vector<float, 3> rotation) {
+        this->rotation = rotation;
+        this->dirty = true;
+    };
+    Vector<float, 3> getScale() { return this->scale; };
+    void setScale(Vector<float, 3> scale) {
+        this->scale = scale;
+        this->dirty = true;
+    };
+    void setScale(float scale) { this->setScale({scale, scale, scale}); };
+
+    Matrix<float, 4, 4> getLocalTransform() const;
+    const Matrix<float, 4, 4>& getWorldTransform();
+    uint64_t getVersion();
+};
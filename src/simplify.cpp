@@ -0,0 +1,257 @@
+#include "simplify.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "object.hpp"
+
+/**
+ * The sum of the squared distances to a set of planes, weighted by the area of
+ * the triangles they came from. Stored as the upper half of a symmetric 4x4 matrix.
+ */
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0, c = 0;
+    double weight = 0;
+
+    static Quadric fromPlane(const Vector<float, 3>& normal, float distance, double weight) {
+        const double x = normal[0], y = normal[1], z = normal[2], d = distance;
+        return Quadric{x * x * weight, x * y * weight, x * z * weight, y * y * weight, y * z * weight, z * z * weight,
+                       x * d * weight, y * d * weight, z * d * weight, d * d * weight, weight};
+    }
+
+    void add(const Quadric& q) {
+        a00 += q.a00, a01 += q.a01, a02 += q.a02, a11 += q.a11, a12 += q.a12, a22 += q.a22;
+        b0 += q.b0, b1 += q.b1, b2 += q.b2, c += q.c;
+        weight += q.weight;
+    }
+
+    /**
+     * Returns the weighted mean squared distance of a point to the planes.
+     */
+    double error(const Vector<float, 3>& p) const {
+        const double x = p[0], y = p[1], z = p[2];
+        double sum = x * (a00 * x + 2 * (a01 * y + a02 * z + b0)) + y * (a11 * y + 2 * (a12 * z + b1)) +
+                     z * (a22 * z + 2 * b2) + c;
+        return weight > 0 ? std::max(sum, 0.0) / weight : 0;
+    }
+};
+
+/**
+ * A candidate collapse of the vertex from onto the vertex to.
+ */
+struct Collapse {
+    uint32_t from, to;
+    double error;
+};
+
+/**
+ * Returns the unnormalized normal of the triangle a, b, c, whose length is twice its area.
+ */
+static Vector<float, 3> faceNormal(const Vector<float, 3>& a, const Vector<float, 3>& b, const Vector<float, 3>& c) {
+    return (b - a).cross(c - a);
+}
+
+/**
+ * Finds the vertices that must not move: the copies of a position split by a texture or
+ * normal seam, the ends of edges without exactly two triangles, and vertices shared by
+ * triangles of different materials. Collapsing any of them would tear the surface
+ * open or drag an attribute or material boundary across it.
+ */
+static std::vector<bool> findLockedVertices(const Object& source, const std::vector<uint32_t>& positions,
+                                            const std::vector<const Material*>& materials) {
+    const size_t vertexCount = source.modelVertices.size();
+    std::vector<bool> locked(vertexCount, false);
+    for (size_t v = 0; v < vertexCount; v++) {
+        if (positions[v] != v) locked[v] = locked[positions[v]] = true;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        if (locked[positions[v]]) locked[v] = true;
+    }
+
+    std::unordered_map<uint64_t, uint32_t> edges;
+    std::vector<const Material*> vertexMaterial(vertexCount, nullptr);
+    for (size_t t = 0; t < materials.size(); t++) {
+        for (size_t i = 0; i < 3; i++) {
+            uint32_t a = positions[source.indices[3 * t + i]], b = positions[source.indices[3 * t + (i + 1) % 3]];
+            edges[uint64_t(std::min(a, b)) << 32 | std::max(a, b)]++;
+
+            const uint32_t vertex = source.indices[3 * t + i];
+            if (vertexMaterial[vertex] && vertexMaterial[vertex] != materials[t]) locked[vertex] = true;
+            vertexMaterial[vertex] = materials[t];
+        }
+    }
+    for (const auto& [edge, count] : edges) {
+        if (count == 2) continue;
+        locked[edge >> 32] = locked[edge & UINT32_MAX] = true;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        if (locked[positions[v]]) locked[v] = true;
+    }
+    return locked;
+}
+
+/**
+ * Returns whether moving the vertex from onto to would flip or collapse one of its
+ * triangles that does not also contain to.
+ */
+static bool flipsTriangle(const std::vector<Vector<float, 3>>& points, const std::vector<uint32_t>& indices,
+                          const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& adjacency, uint32_t from,
+                          uint32_t to) {
+    const Vector<float, 3>& target = points[to];
+    for (uint32_t i = offsets[from]; i < offsets[from + 1]; i++) {
+        const uint32_t* corners = &indices[3 * adjacency[i]];
+        if (corners[0] == to || corners[1] == to || corners[2] == to) continue;
+
+        Vector<float, 3> v[3], moved[3];
+        for (size_t j = 0; j < 3; j++) {
+            v[j] = points[corners[j]];
+            moved[j] = corners[j] == from ? target : v[j];
+        }
+        Vector<float, 3> before = faceNormal(v[0], v[1], v[2]);
+        Vector<float, 3> after = faceNormal(moved[0], moved[1], moved[2]);
+        if (after.dot(before) <= 0.25f * before.norm() * after.norm()) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Simplifies an Object by collapsing edges until at most targetCount triangles are left.
+ *
+ * Uses quadric error metrics: every vertex accumulates the planes of the triangles
+ * around it, and collapsing an edge onto one of its ends costs the mean squared
+ * distance of that end to the planes of both vertices. Collapses only ever move a
+ * vertex onto an existing one, so the result uses a subset of the source's vertices
+ * with their texture coordinates and normals unchanged. Collapses are done in
+ * passes, cheapest first, with each vertex involved in at most one collapse per pass.
+ * Seams, borders and material boundaries stay in place, and collapses moving the
+ * surface further than maxError are not done, either of which can stop the
+ * simplification before targetCount is reached.
+ *
+ * @param source The Object to simplify. Its model vertices must be final.
+ * @param targetCount The number of triangles to simplify to.
+ * @param maxError The largest error, in model space, a collapse may have.
+ * @param result Receives the simplified Object, with its own compacted vertex arrays
+ * and the source's triangle order and material ranges.
+ * @return The largest error of the collapses done: the area-weighted RMS distance, in
+ * model space, of the kept vertex to the planes of both collapsed vertices. This is an
+ * estimate of how far the surface moved, not a bound on it.
+ */
+float simplify(const Object& source, uint32_t targetCount, float maxError, Object& result) {
+    const size_t vertexCount = source.modelVertices.size();
+    std::vector<uint32_t> indices = source.indices;
+
+    std::vector<const Material*> materials;
+    for (const MaterialRange& range : source.materialRanges) materials.insert(materials.end(), range.count, range.material);
+
+    // The first vertex at each position, so seams are found and share one quadric
+    std::vector<uint32_t> positions(vertexCount);
+    std::unordered_map<std::string_view, uint32_t> firstAtPosition;
+    std::vector<Vector<float, 3>> points(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        points[v] = source.modelVertices[v];
+        std::string_view key(reinterpret_cast<const char*>(&points[v]), sizeof(Vector<float, 3>));
+        positions[v] = firstAtPosition.emplace(key, v).first->second;
+    }
+    std::vector<bool> locked = findLockedVertices(source, positions, materials);
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < indices.size() / 3; t++) {
+        const uint32_t* corners = &indices[3 * t];
+        Vector<float, 3> normal = faceNormal(points[corners[0]], points[corners[1]], points[corners[2]]);
+        float area = normal.norm();
+        if (area <= 0) continue;
+        normal = normal / area;
+
+        Quadric quadric = Quadric::fromPlane(normal, -normal.dot(points[corners[0]]), area / 2);
+        for (size_t i = 0; i < 3; i++) quadrics[positions[corners[i]]].add(quadric);
+    }
+
+    float error = 0;
+    std::vector<uint32_t> offsets(vertexCount + 1), adjacency, remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<Collapse> collapses;
+    uint32_t triangleCount = indices.size() / 3;
+
+    while (triangleCount > targetCount) {
+        // The triangles around each vertex
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (uint32_t vertex : indices) offsets[vertex + 1]++;
+        for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+        adjacency.resize(indices.size());
+        std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) adjacency[filled[indices[i]]++] = i / 3;
+
+        collapses.clear();
+        for (size_t i = 0; i < indices.size(); i++) {
+            const uint32_t a = indices[i], b = indices[i - i % 3 + (i + 1) % 3];
+            Quadric quadric = quadrics[positions[a]];
+            quadric.add(quadrics[positions[b]]);
+            if (!locked[a]) collapses.push_back(Collapse{a, b, quadric.error(points[b])});
+            if (!locked[b]) collapses.push_back(Collapse{b, a, quadric.error(points[a])});
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        for (uint32_t v = 0; v < vertexCount; v++) remap[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+
+        // Every collapse removes the two triangles sharing its edge
+        uint32_t removed = 0;
+        for (const Collapse& collapse : collapses) {
+            if (triangleCount - removed <= targetCount || collapse.error > double(maxError) * maxError) break;
+            if (collapse.from == collapse.to || touched[collapse.from] || touched[collapse.to]) continue;
+            if (flipsTriangle(points, indices, offsets, adjacency, collapse.from, collapse.to)) continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[positions[collapse.to]].add(quadrics[positions[collapse.from]]);
+            error = std::max(error, float(std::sqrt(collapse.error)));
+
+            // Neighbouring triangles change shape, so their vertices wait for the next pass
+            for (uint32_t i = offsets[collapse.from]; i < offsets[collapse.from + 1]; i++) {
+                const uint32_t* corners = &indices[3 * adjacency[i]];
+                if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to) removed++;
+                for (size_t j = 0; j < 3; j++) touched[corners[j]] = true;
+            }
+        }
+        if (removed == 0) break;
+
+        size_t kept = 0;
+        for (size_t t = 0; t < indices.size() / 3; t++) {
+            uint32_t a = remap[indices[3 * t]], b = remap[indices[3 * t + 1]], c = remap[indices[3 * t + 2]];
+            if (a == b || b == c || c == a) continue;
+            indices[3 * kept] = a;
+            indices[3 * kept + 1] = b;
+            indices[3 * kept + 2] = c;
+            materials[kept++] = materials[t];
+        }
+        indices.resize(3 * kept);
+        materials.resize(kept);
+        triangleCount = kept;
+    }
+
+    // Copy the vertices that are still used, keeping the placeholder at index 0
+    result = Object{source.name};
+    std::fill(remap.begin(), remap.end(), UINT32_MAX);
+    remap[0] = 0;
+    result.modelVertices.push_back(source.modelVertices[0]);
+    result.modelNormals.push_back(source.modelNormals[0]);
+    result.textures.push_back(source.textures[0]);
+    for (uint32_t& index : indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = result.modelVertices.size();
+            result.modelVertices.push_back(source.modelVertices[index]);
+            result.modelNormals.push_back(source.modelNormals[index]);
+            result.textures.push_back(source.textures[index]);
+        }
+        index = remap[index];
+    }
+    for (uint32_t t = 0; t < triangleCount; t++) result.addTriangle(&indices[3 * t], *materials[t]);
+
+    result.vertices = result.modelVertices;
+    result.normals = result.modelNormals;
+    result.bounds = Bounds::fromPoints(result.modelVertices);
+    return error;
+}
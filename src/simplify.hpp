@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+struct Object;
+
+float simplify(const Object& source, uint32_t targetCount, float maxError, Object& result);
@@ -0,0 +1,204 @@
+#include "texture.hpp"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+/**
+ * Averages four packed RGBA8 colors, rounding to nearest. Two channels are added at
+ * once, each in its own 16-bit half of a 32-bit integer.
+ */
+static uint32_t average(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    const uint32_t low = (a & 0x00FF00FF) + (b & 0x00FF00FF) + (c & 0x00FF00FF) + (d & 0x00FF00FF) + 0x00020002;
+    const uint32_t high = (a >> 8 & 0x00FF00FF) + (b >> 8 & 0x00FF00FF) + (c >> 8 & 0x00FF00FF) + (d >> 8 & 0x00FF00FF) + 0x00020002;
+    return (low >> 2 & 0x00FF00FF) | (high << 6 & 0xFF00FF00);
+}
+
+/**
+ * Bilinearly blends four packed RGBA8 colors, two channels at a time like average().
+ * The four weights add up to 256, so no channel overflows its 16 bits, and their
+ * products do not depend on each other.
+ *
+ * @param c00, c10, c01, c11 The top-left, top-right, bottom-left and bottom-right colors.
+ * @param wx, wy How far the point is towards the right and bottom colors, from 0 to 255.
+ */
+static uint32_t bilinear(uint32_t c00, uint32_t c10, uint32_t c01, uint32_t c11, uint32_t wx, uint32_t wy) {
+    const uint32_t w11 = wx * wy >> 8, w10 = wx - w11, w01 = wy - w11, w00 = 256 - wx - wy + w11;
+    const uint32_t low = ((c00 & 0x00FF00FF) * w00 + (c10 & 0x00FF00FF) * w10 + (c01 & 0x00FF00FF) * w01 +
+                          (c11 & 0x00FF00FF) * w11) >> 8 & 0x00FF00FF;
+    const uint32_t high = ((c00 >> 8 & 0x00FF00FF) * w00 + (c10 >> 8 & 0x00FF00FF) * w10 + (c01 >> 8 & 0x00FF00FF) * w01 +
+                           (c11 >> 8 & 0x00FF00FF) * w11) & 0xFF00FF00;
+    return low | high;
+}
+
+/**
+ * @brief Creates a Texture from its full-resolution texels and builds its mip chain.
+ *
+ * Every level is a 2x2 box filter of the one before. Levels with an odd size reuse
+ * the last row or column of the level before. The chain is built row by row and
+ * then stored in the requested layout, where tiled levels are padded to whole tiles.
+ *
+ * @param width, height The size of the texture in texels.
+ * @param pixels The texels, packed RGBA8 and row by row.
+ * @param layout The order to store the texels in.
+ * @throws std::runtime_error if the size is not positive or does not match the texels.
+ */
+Texture::Texture(int width, int height, std::vector<uint32_t> pixels, TextureLayout layout) : layout(layout) {
+    if (width <= 0 || height <= 0 || pixels.size() != size_t(width) * height)
+        throw std::runtime_error("Invalid texture size: " + std::to_string(width) + "x" + std::to_string(height));
+
+    // The levels row by row, one after the other
+    std::vector<uint32_t> chain = std::move(pixels);
+    std::vector<size_t> rowOffsets = {0};
+    levels.push_back(MipLevel{width, height});
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const MipLevel source = levels.back();
+        const MipLevel level = {std::max(source.width / 2, 1), std::max(source.height / 2, 1)};
+        rowOffsets.push_back(chain.size());
+        chain.resize(rowOffsets.back() + size_t(level.width) * level.height);
+
+        const uint32_t* from = chain.data() + rowOffsets[rowOffsets.size() - 2];
+        uint32_t* to = chain.data() + rowOffsets.back();
+        for (int y = 0; y < level.height; y++) {
+            const uint32_t* row0 = from + std::min(2 * y, source.height - 1) * source.width;
+            const uint32_t* row1 = from + std::min(2 * y + 1, source.height - 1) * source.width;
+            for (int x = 0; x < level.width; x++) {
+                const int x0 = std::min(2 * x, source.width - 1), x1 = std::min(2 * x + 1, source.width - 1);
+                to[y * level.width + x] = average(row0[x0], row0[x1], row1[x0], row1[x1]);
+            }
+        }
+        levels.push_back(level);
+    }
+
+    size_t size = 0;
+    for (MipLevel& level : levels) {
+        level.tilesPerRow = (level.width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        level.offset = size;
+        const int rows = (level.height + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        size += layout == TEXTURE_TILED ? size_t(level.tilesPerRow) * rows * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE
+                                        : size_t(level.width) * level.height;
+    }
+
+    texels.resize(size);
+    for (size_t i = 0; i < levels.size(); i++) {
+        const uint32_t* from = chain.data() + rowOffsets[i];
+        for (int y = 0; y < levels[i].height; y++) {
+            for (int x = 0; x < levels[i].width; x++) texels[address(levels[i], x, y)] = from[y * levels[i].width + x];
+        }
+    }
+}
+
+/**
+ * Returns the full-resolution texels row by row, whatever the layout they are stored in.
+ */
+std::vector<uint32_t> Texture::getPixels() const {
+    const MipLevel& level = levels[0];
+    std::vector<uint32_t> pixels(size_t(level.width) * level.height);
+    for (int y = 0; y < level.height; y++) {
+        for (int x = 0; x < level.width; x++) pixels[size_t(y) * level.width + x] = texels[address(level, x, y)];
+    }
+    return pixels;
+}
+
+/**
+ * @brief Loads an image file and converts it to a Texture.
+ *
+ * Failures are reported with the error of the SDL call that failed.
+ *
+ * @param path The path to the image.
+ * @return The texture, or null if the image could not be loaded or converted.
+ */
+std::unique_ptr<Texture> Texture::load(const std::string& path) {
+    SDL_Surface* image = IMG_Load(path.c_str());
+    if (!image) {
+        std::cerr << "Failed to load image: " << IMG_GetError() << std::endl;
+        return nullptr;
+    }
+
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_RGBA8888, 0);
+    SDL_FreeSurface(image);
+    if (!converted) {
+        std::cerr << "Failed to convert image: " << path << ": " << SDL_GetError() << std::endl;
+        return nullptr;
+    }
+
+    const int width = converted->w, height = converted->h;
+    if (width <= 0 || height <= 0) {
+        SDL_FreeSurface(converted);
+        return nullptr;
+    }
+
+    std::vector<uint32_t> pixels(size_t(width) * height);
+    for (int y = 0; y < height; y++) {
+        memcpy(&pixels[size_t(y) * width], static_cast<const char*>(converted->pixels) + y * converted->pitch,
+               width * sizeof(uint32_t));
+    }
+    SDL_FreeSurface(converted);
+    return std::make_unique<Texture>(width, height, std::move(pixels));
+}
+
+/**
+ * @brief Picks the level of detail for a pixel from how fast the texture
+ * coordinates change around it.
+ *
+ * @param dudx, dvdx How much u and v change from a pixel to the one on its right.
+ * @param dudy, dvdy How much u and v change from a pixel to the one below it.
+ * @return The base-2 logarithm of the number of full-resolution texels a pixel
+ * spans along its longer axis. 0 or less is the full-resolution level, and every
+ * step up halves the resolution.
+ */
+float Texture::getLevel(float dudx, float dvdx, float dudy, float dvdy) const {
+    const float width = float(levels[0].width), height = float(levels[0].height);
+    const float x = dudx * width * (dudx * width) + dvdx * height * (dvdx * height);
+    const float y = dudy * width * (dudy * width) + dvdy * height * (dvdy * height);
+    return 0.5f * std::log2(std::max(std::max(x, y), 1e-12f));
+}
+
+/**
+ * @brief Bilinearly filters the texels around a point on the nearest mip level.
+ *
+ * Coordinates outside [0, 1] are clamped to the edge, and v points up, so v = 1 is
+ * the first row. The filter weights have 8 bits of precision and are applied to
+ * the packed texels with integer math. In the tiled layout, the four texels share
+ * one cache line unless they straddle a tile boundary.
+ *
+ * @param u, v The texture coordinates to sample at.
+ * @param level The level of detail, as returned by getLevel().
+ * @return The filtered color, packed RGBA8.
+ */
+uint32_t Texture::sample(float u, float v, float level) const {
+    const int index = level > 0.5f ? int(std::min(level + 0.5f, float(levels.size() - 1))) : 0;
+    const MipLevel& mip = levels[index];
+
+    // Texel centers sit at half-integer coordinates, so the four nearest ones never
+    // lie more than one texel outside the level. Offsetting by a texel keeps the
+    // coordinates positive, so truncating them rounds down.
+    const float x = std::min(std::max(u, 0.0f), 1.0f) * mip.width + 0.5f;
+    const float y = (1 - std::min(std::max(v, 0.0f), 1.0f)) * mip.height + 0.5f;
+    const int fx = int(x * 256) - 256, fy = int(y * 256) - 256;
+
+    const int x0 = std::max(fx >> 8, 0), x1 = std::min((fx >> 8) + 1, mip.width - 1);
+    const int y0 = std::max(fy >> 8, 0), y1 = std::min((fy >> 8) + 1, mip.height - 1);
+    // How far the texel to the right and the one below are, which lie in the next tile at tile edges
+    size_t right, down;
+    if (layout == TEXTURE_LINEAR) {
+        right = x1 - x0;
+        down = size_t(y1 - y0) * mip.width;
+    } else {
+        const int last = TEXTURE_TILE_SIZE - 1;
+        right = x1 == x0 ? 0 : x0 % TEXTURE_TILE_SIZE == last ? TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE - last : 1;
+        down = y1 == y0 ? 0
+               : y0 % TEXTURE_TILE_SIZE == last ? size_t(mip.tilesPerRow) * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE - last * TEXTURE_TILE_SIZE
+                                                : TEXTURE_TILE_SIZE;
+    }
+
+    const uint32_t* texel = &texels[address(mip, x0, y0)];
+    const uint32_t c00 = texel[0], c10 = texel[right], c01 = texel[down], c11 = texel[down + right];
+
+    return bilinear(c00, c10, c01, c11, fx & 0xFF, fy & 0xFF);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aligned.hpp"
+
+// Tiled textures store square tiles of TEXTURE_TILE_SIZE x TEXTURE_TILE_SIZE texels, one cache line each
+#define TEXTURE_TILE_SIZE 4
+#define CACHE_LINE_SIZE 64
+
+/**
+ * How a Texture orders its texels in memory. TEXTURE_LINEAR stores them row by
+ * row. TEXTURE_TILED stores them in TEXTURE_TILE_SIZE x TEXTURE_TILE_SIZE tiles,
+ * themselves row by row, so texels that are close in both u and v share a cache line.
+ */
+enum TextureLayout {
+    TEXTURE_LINEAR,
+    TEXTURE_TILED
+};
+
+/**
+ * One level of a Texture's mip chain: its size, its width in tiles and where its
+ * texels start.
+ */
+struct MipLevel {
+    int width, height;
+    int tilesPerRow;
+    size_t offset;
+};
+
+/**
+ * A texture in the renderer's own layout: packed RGBA8 texels (0xRRGGBBAA, like the
+ * color buffer) followed by every level of its mip chain down to 1x1, each half the
+ * size of the one before.
+ *
+ * Textures are converted once when they are loaded, so sampling never goes through
+ * an SDL_PixelFormat and minified textures are read from a level of about the size
+ * they are drawn at.
+ */
+class Texture {
+   private:
+    static inline TextureLayout defaultLayout = TEXTURE_LINEAR;
+
+    TextureLayout layout;
+    std::vector<uint32_t, AlignedAllocator<uint32_t, CACHE_LINE_SIZE>> texels;
+    std::vector<MipLevel> levels;
+
+    size_t address(const MipLevel& level, uint32_t x, uint32_t y) const {
+        if (layout == TEXTURE_LINEAR) return level.offset + size_t(y) * level.width + x;
+
+        const size_t tile = size_t(y / TEXTURE_TILE_SIZE) * level.tilesPerRow + x / TEXTURE_TILE_SIZE;
+        return level.offset + tile * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE + y % TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE +
+               x % TEXTURE_TILE_SIZE;
+    }
+
+   public:
+    Texture(int width, int height, std::vector<uint32_t> pixels, TextureLayout layout = defaultLayout);
+    static std::unique_ptr<Texture> load(const std::string& path);
+
+    static TextureLayout getDefaultLayout() { return defaultLayout; }
+    static void setDefaultLayout(TextureLayout layout) { defaultLayout = layout; }
+
+    int getWidth() const { return levels[0].width; }
+    int getHeight() const { return levels[0].height; }
+    TextureLayout getLayout() const { return layout; }
+    std::vector<uint32_t> getPixels() const;
+
+    float getLevel(float dudx, float dvdx, float dudy, float dvdy) const;
+    uint32_t sample(float u, float v, float level) const;
+};
@@ -0,0 +1,59 @@
+#include "texturecache.hpp"
+
+#include <filesystem>
+#include <iterator>
+
+TextureCache& TextureCache::getInstance() {
+    static TextureCache instance;
+    return instance;
+}
+
+/**
+ * Returns the absolute, normalized form of a path, with symbolic links resolved as
+ * far as it exists, so that every way of naming a file maps to the same key.
+ */
+std::string TextureCache::resolve(const std::string& path) {
+    std::error_code error;
+    std::filesystem::path resolved = std::filesystem::weakly_canonical(path, error);
+    if (error) resolved = std::filesystem::absolute(path, error).lexically_normal();
+    return resolved.string();
+}
+
+/**
+ * @brief Returns the texture of an image file, loading it only if it is not in use yet.
+ *
+ * @param path The path to the image.
+ * @return The shared texture, or null if the image could not be loaded or converted.
+ */
+std::shared_ptr<Texture> TextureCache::get(const std::string& path) {
+    return get(path, [&] { return Texture::load(path); });
+}
+
+/**
+ * @brief Returns the texture of an image file, creating it only if it is not in use yet.
+ *
+ * Every miss also drops the entries of textures that have been freed since, so the
+ * cache never holds more entries than textures in use plus the one being created.
+ *
+ * @param path The path to the image, which identifies the texture.
+ * @param create Creates the texture if no material uses it anymore. May return null,
+ * in which case nothing is cached.
+ * @return The shared texture, or null if it had to be created and could not be.
+ */
+std::shared_ptr<Texture> TextureCache::get(const std::string& path,
+                                           const std::function<std::unique_ptr<Texture>()>& create) {
+    const std::string key = resolve(path);
+    auto found = textures.find(key);
+    if (found != textures.end()) {
+        if (std::shared_ptr<Texture> texture = found->second.lock()) return texture;
+    }
+
+    for (auto it = textures.begin(); it != textures.end();) {
+        it = it->second.expired() ? textures.erase(it) : std::next(it);
+    }
+
+    std::shared_ptr<Texture> texture = create();
+    if (texture) textures[key] = texture;
+    return texture;
+}
+
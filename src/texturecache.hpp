@@ -0,0 +1,33 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "texture.hpp"
+
+/**
+ * A process-wide cache of the textures in use, keyed by the resolved path of their
+ * image file.
+ *
+ * Materials hold shared references to the textures they get from the cache, and the
+ * cache only keeps weak ones, so loading the same asset again shares its decoded
+ * texels and mip chain instead of decoding them again, and a texture is freed as
+ * soon as the last material using it is.
+ */
+class TextureCache {
+   private:
+    std::unordered_map<std::string, std::weak_ptr<Texture>> textures;
+
+    TextureCache() = default;
+    static std::string resolve(const std::string& path);
+
+   public:
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+    static TextureCache& getInstance();
+
+    std::shared_ptr<Texture> get(const std::string& path);
+    std::shared_ptr<Texture> get(const std::string& path, const std::function<std::unique_ptr<Texture>()>& create);
+};
@@ -1,60 +1,102 @@
 #include "triangle.hpp"
 
 #include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <cmath>
 #include <limits>
-#include <omp.h>
 
 #include "object.hpp"
 
 #define RGBA(r, g, b, a) ((r & 0xFF) << 24 | (g & 0xFF) << 16 | (b & 0xFF) << 8 | (a & 0xFF))
 #define CLAMP(x, min, max) ((x) < (min) ? (min) : ((x) > (max) ? (max) : (x)))
 #define MISSING_COLOR RGBA(255, 255, 255, 255)
+#define BLOCK_SIZE 8
 
-const Vector<float, 3>& Triangle::V(uint32_t i) const { return object.vertices[vidx[i]]; }
-const Vector<float, 2>& Triangle::T(uint32_t i) const { return object.textures[uvidx[i]]; }
-const Vector<float, 3>& Triangle::N(uint32_t i) const { return object.normals[nidx[i]]; }
+// Four lanes of a 2x2 pixel quad, in the order (x, y), (x + 1, y), (x, y + 1), (x + 1, y + 1).
+// GCC lowers these to SSE on x86 and to NEON or scalar code elsewhere.
+typedef float float4 __attribute__((vector_size(16)));
+typedef int int4 __attribute__((vector_size(16)));
 
-bool Triangle::AllOutOfBounds() {
-    int w, h;
-    SDL_GetWindowSize(window.getWindow(), &w, &h);
-    return !inBounds(V(0)[0], V(0)[1], w, h) &&
-           !inBounds(V(1)[0], V(1)[1], w, h) &&
-           !inBounds(V(2)[0], V(2)[1], w, h);
-};
+static const float4 QUAD_X = {0.5f, 1.5f, 0.5f, 1.5f};
+static const float4 QUAD_Y = {0.5f, 0.5f, 1.5f, 1.5f};
+static const int4 QUAD_DX = {0, 1, 0, 1};
+static const int4 QUAD_DY = {0, 0, 1, 1};
 
-void Triangle::drawPixel(int x, int y, uint32_t color) {
-    SDL_SetRenderDrawColor(window.getRenderer(), R(color), G(color), B(color), A(color));
-    SDL_RenderDrawPoint(window.getRenderer(), x, y);
+static bool any(int4 mask) { return mask[0] | mask[1] | mask[2] | mask[3]; }
+static bool all(int4 mask) { return mask[0] & mask[1] & mask[2] & mask[3]; }
+
+/**
+ * The half-space a * x + b * y + c >= 0 to the inside of one triangle edge.
+ *
+ * The coefficients of an edge shared by two triangles are exact negations of each
+ * other, and so is every value evaluated from them. Together with the top-left
+ * rule this assigns each pixel center on a shared edge to exactly one triangle.
+ */
+struct Edge {
+    float a, b, c;
+    bool top_left;
+
+    float4 eval(float4 x, float4 y) const { return a * x + (b * y + c); }
+    float eval(float x, float y) const { return a * x + (b * y + c); }
+    int4 covers(float4 f) const { return top_left ? f >= 0 : f > 0; }
 };
 
-uint32_t Triangle::sample(Vector<float, 2>& uv) {
-    if (!material.image) return MISSING_COLOR;
+uint32_t Triangle::vertexIndex(uint32_t i) const { return object->indices[3 * index + i]; }
 
-    uint32_t* pixels = (uint32_t*)material.image->pixels;
-    SDL_PixelFormat* format = material.image->format;
+Vector<float, 3> Triangle::V(uint32_t i) const { return object->vertices[base + vertexIndex(i)]; }
+const Vector<float, 2>& Triangle::T(uint32_t i) const { return object->textures[vertexIndex(i)]; }
+Vector<float, 3> Triangle::N(uint32_t i) const { return object->normals[base + vertexIndex(i)]; }
 
-    float x = std::min(std::max(uv[0], 0.0f), 1.0f) * material.image->w;
-    float y = (1 - std::min(std::max(uv[1], 0.0f), 1.0f)) * material.image->h;
-    float dx = x - floor(x);
-    float dy = y - floor(y);
+/**
+ * @brief Builds the attribute planes of the triangle from its barycentric weights.
+ *
+ * Every attribute divided by w is the barycentric combination of its values at the
+ * three vertices, so its plane follows from the weights at the anchor point and
+ * their gradients. This moves all per-vertex work out of the per-pixel loops.
+ *
+ * @param weights The barycentric weights of the vertices at the anchor point.
+ * @param weights_dx How much the weights change per pixel to the right.
+ * @param weights_dy How much the weights change per row down.
+ */
+AttributePlanes Triangle::getAttributePlanes(const Vector<float, 3>& weights, const Vector<float, 3>& weights_dx,
+                                             const Vector<float, 3>& weights_dy) const {
+    float attributes[3][ATTRIBUTE_COUNT];
+    for (uint32_t i = 0; i < 3; i++) {
+        const float w = 1 / V(i)[2];
+        const Vector<float, 2>& uv = T(i);
+        const Vector<float, 3> n = N(i);
+        const float values[ATTRIBUTE_COUNT] = {w, uv[0] * w, uv[1] * w, n[0] * w, n[1] * w, n[2] * w};
+        std::copy(values, values + ATTRIBUTE_COUNT, attributes[i]);
+    }
 
-    uint32_t c0 = pixels[(int)floor(y) * material.image->w + (int)floor(x)];
-    uint32_t c1 = pixels[(int)floor(y) * material.image->w + (int)ceil(x)];
-    uint32_t c2 = pixels[(int)ceil(y) * material.image->w + (int)floor(x)];
-    uint32_t c3 = pixels[(int)ceil(y) * material.image->w + (int)ceil(x)];
+    AttributePlanes planes;
+    for (size_t k = 0; k < ATTRIBUTE_COUNT; k++) {
+        planes.value[k] = attributes[0][k] * weights[0] + attributes[1][k] * weights[1] + attributes[2][k] * weights[2];
+        planes.dx[k] = attributes[0][k] * weights_dx[0] + attributes[1][k] * weights_dx[1] + attributes[2][k] * weights_dx[2];
+        planes.dy[k] = attributes[0][k] * weights_dy[0] + attributes[1][k] * weights_dy[1] + attributes[2][k] * weights_dy[2];
+    }
+    return planes;
+}
 
-    uint8_t r0, g0, b0, a0, r1, g1, b1, a1, r2, g2, b2, a2, r3, g3, b3, a3;
-    SDL_GetRGBA(c0, format, &r0, &g0, &b0, &a0);
-    SDL_GetRGBA(c1, format, &r1, &g1, &b1, &a1);
-    SDL_GetRGBA(c2, format, &r2, &g2, &b2, &a2);
-    SDL_GetRGBA(c3, format, &r3, &g3, &b3, &a3);
+/**
+ * Adds scale times a gradient to a set of attribute values.
+ */
+template <typename T>
+static void step(T values[ATTRIBUTE_COUNT], const float gradient[ATTRIBUTE_COUNT], float scale = 1.0f) {
+    for (size_t k = 0; k < ATTRIBUTE_COUNT; k++) values[k] += gradient[k] * scale;
+}
 
-    uint8_t r = lerp(lerp(r0, r1, dx), lerp(r2, r3, dx), dy);
-    uint8_t g = lerp(lerp(g0, g1, dx), lerp(g2, g3, dx), dy);
-    uint8_t b = lerp(lerp(b0, b1, dx), lerp(b2, b3, dx), dy);
-    uint8_t a = lerp(lerp(a0, a1, dx), lerp(a2, a3, dx), dy);
+void Triangle::drawPixel(int x, int y, uint32_t color) {
+    Window& window = Window::getInstance();
+    window.getColorBuffer()->at(x + y * window.getWidth()) = color;
+};
 
-    return RGBA(r, g, b, a);
+/**
+ * Samples the material's texture at the given texture coordinates and level of detail.
+ */
+uint32_t Triangle::sample(Vector<float, 2>& uv, float level) {
+    if (!material->texture) return MISSING_COLOR;
+    return material->texture->sample(uv[0], uv[1], level);
 }
 
 /**
@@ -73,8 +115,8 @@ void Triangle::drawLine(const Vector<float, 3>& v1, const Vector<float, 3>& v2)
     int sy = (y < y1) ? 1 : -1;
     int err = dx - dy;
 
-    int width, height;
-    SDL_GetWindowSize(window.getWindow(), &width, &height);
+    Window& window = Window::getInstance();
+    const int width = window.getWidth(), height = window.getHeight();
 
     while (true) {
         if (inBounds(x, y, width, height)) drawPixel(x, y, 0xFF0000FF);
@@ -101,11 +143,11 @@ void Triangle::draw() {
     drawLine(V(2), V(0));
 }
 
-uint32_t Triangle::fragmentShader(int x, int y, float z, Vector<float, 2>& uv, Vector<float, 3>& n) {
+uint32_t Triangle::fragmentShader(int x, int y, float z, Vector<float, 2>& uv, Vector<float, 3>& n, float level) {
     uint32_t color = UINT32_MAX;
 
     // Texture Shader
-    color = sample(uv);
+    color = sample(uv, level);
 
     // Lighting Shader
     float c = CLAMP(n.dot({0, 0, 1}), 0, 1);
@@ -118,48 +160,83 @@ uint32_t Triangle::fragmentShader(int x, int y, float z, Vector<float, 2>& uv, V
     return color;
 }
 
-void Triangle::getXBounds(Vector<float, 3> v[3], int x_starts[], int x_ends[]) {
+/**
+ * Computes the horizontal span covered by the triangle on each row in [y0, y1].
+ *
+ * Every row is evaluated directly from the edge slopes rather than stepped from the
+ * top vertex, so the span of a row does not depend on which rows were requested.
+ * This is what lets tiles rasterize disjoint row ranges of the same triangle and
+ * still produce exactly the pixels a single full-screen pass would.
+ *
+ * @param v The vertices of the triangle sorted by y-coordinate (top to bottom).
+ * @param y0 The first row to compute.
+ * @param y1 The last row to compute.
+ * @param x_starts Receives the first covered column of each row.
+ * @param x_ends Receives the last covered column of each row.
+ */
+void Triangle::getXBounds(Vector<float, 3> v[3], int y0, int y1, int x_starts[], int x_ends[]) {
     float dx1 = (v[1][0] - v[0][0]) / (v[1][1] - v[0][1] + 1e-6);
     float dx2 = (v[2][0] - v[0][0]) / (v[2][1] - v[0][1] + 1e-6);
     float dx3 = (v[2][0] - v[1][0]) / (v[2][1] - v[1][1] + 1e-6);
 
     bool middleIsOnLeft = dx1 < dx2;
-    float ds = middleIsOnLeft ? dx1 : dx2;
-    float de = middleIsOnLeft ? dx2 : dx1;
-    float xs = v[0][0], xe = v[0][0];
-
     int y_start = static_cast<int>(std::round(v[0][1]));
     int y_mid = static_cast<int>(std::round(v[1][1]));
-    int y_end = static_cast<int>(std::round(v[2][1]));
 
-    for (int y = y_start; y < y_mid; y++) {
-        x_starts[y - y_start] = std::floor(xs);
-        x_ends[y - y_start] = std::ceil(xe);
-        xs += ds;
-        xe += de;
+    for (int y = y0; y <= y1; y++) {
+        float x_long = v[0][0] + dx2 * (y - y_start);
+        float x_short = y < y_mid ? v[0][0] + dx1 * (y - y_start) : v[1][0] + dx3 * (y - y_mid);
+        x_starts[y - y0] = std::floor(middleIsOnLeft ? x_short : x_long);
+        x_ends[y - y0] = std::ceil(middleIsOnLeft ? x_long : x_short);
     }
+}
 
-    ds = middleIsOnLeft ? dx3 : dx2;
-    de = middleIsOnLeft ? dx2 : dx3;
-    if (middleIsOnLeft) xs = v[1][0];
-    else xe = v[1][0];
-
-    for (int y = y_mid; y <= y_end; y++) {
-        x_starts[y - y_start] = std::floor(xs);
-        x_ends[y - y_start] = std::ceil(xe);
-        xs += ds;
-        xe += de;
-    }
+/**
+ * Computes the screen-space bounding box of the triangle, clamped to the window.
+ * The result is empty if the triangle does not overlap the window.
+ */
+Rect Triangle::getBounds() const {
+    Window& window = Window::getInstance();
+    const float w = window.getWidth(), h = window.getHeight();
+    float min_x = std::min({V(0)[0], V(1)[0], V(2)[0]});
+    float max_x = std::max({V(0)[0], V(1)[0], V(2)[0]});
+    float min_y = std::min({V(0)[1], V(1)[1], V(2)[1]});
+    float max_y = std::max({V(0)[1], V(1)[1], V(2)[1]});
+
+    // Clamp before converting so that vertices far off screen cannot overflow an int
+    return Rect{static_cast<int>(std::floor(std::min(std::max(0.0f, min_x), w))),
+                static_cast<int>(std::round(std::min(std::max(0.0f, min_y), h))),
+                static_cast<int>(std::ceil(std::max(std::min(w - 1, max_x), -1.0f))),
+                static_cast<int>(std::round(std::max(std::min(h - 1, max_y), -1.0f)))};
 }
 
-void Triangle::fill() {
-    if (AllOutOfBounds()) return;
+/**
+ * Rasterizes the part of the triangle that falls inside the given tile.
+ *
+ * Pixels are only ever written inside the tile, so tiles that do not overlap
+ * can be filled concurrently without synchronizing on the depth or color buffer.
+ * Attributes and barycentric coordinates come from their plane equations, stepped
+ * along each row pixel by pixel.
+ *
+ * @param tile The region of the screen to rasterize.
+ * @param visibility The visibility buffer to write visible pixels to, to be shaded
+ * later by shade(). Pixels are shaded right away if it is null.
+ * @param id The number the triangle is known by in the visibility buffer.
+ */
+void Triangle::fill(const Rect& tile, Fragment* visibility, uint32_t id) {
     float twice_area = edge_cross(V(0), V(1), V(2));
-    if (twice_area > -1) return;
+    if (std::fabs(twice_area) < 1) return;
     const float inv_twice_area = 1.0f / twice_area;
 
-    int width, height;
-    SDL_GetWindowSize(window.getWindow(), &width, &height);
+    Rect bounds = getBounds();
+    Rect r = {std::max(bounds.x0, tile.x0), std::max(bounds.y0, tile.y0),
+              std::min(bounds.x1, tile.x1), std::min(bounds.y1, tile.y1)};
+    if (r.empty()) return;
+
+    Window& window = Window::getInstance();
+    const int width = window.getWidth();
+    float* depth_buffer = window.getDepthBuffer()->data();
+    uint32_t* color_buffer = window.getColorBuffer()->data();
 
     // Sort vertices by y-coordinate (top to bottom)
     Vector<float, 3> v[] = {V(0), V(1), V(2)};
@@ -172,68 +249,213 @@ void Triangle::fill() {
     Vector<float, 3> delta_row = Vector<float, 3>{V(2)[0] - V(1)[0], V(0)[0] - V(2)[0], V(1)[0] - V(0)[0]} * inv_twice_area;
     Vector<float, 3> coord_init = Vector<float, 3>{edge_cross(V(1), V(2), v[0]), edge_cross(V(2), V(0), v[0]), edge_cross(V(0), V(1), v[0])} * inv_twice_area;
 
-    // Perspective-correct interpolation setup
-    Vector<float, 3> zinv = {1 / V(0)[2], 1 / V(1)[2], 1 / V(2)[2]};
-    Matrix<float, 3, 3> pn = Matrix<float, 3, 3>({N(0) * zinv[0], N(1) * zinv[1], N(2) * zinv[2]}).transpose();
-    Matrix<float, 2, 3> puv = Matrix<float, 3, 2>({T(0) * zinv[0], T(1) * zinv[1], T(2) * zinv[2]}).transpose();
+    const float db0 = delta_col[0], db1 = delta_col[1], db2 = delta_col[2];
 
-    int y_start = static_cast<int>(std::round(v[0][1]));
-    int y_end = static_cast<int>(std::round(v[2][1]));
-    int x_starts[y_end - y_start + 1];
-    int x_ends[y_end - y_start + 1];
-    getXBounds(v, x_starts, x_ends);
-
-    struct Pixel {
-        int x, y;
-        uint32_t color;
-    };
-    std::vector<Pixel> pixels;
-    std::vector<std::vector<Pixel>> thread_pixels(omp_get_max_threads());
+    // Perspective-correct interpolation setup, with the attribute planes anchored at the top vertex
+    const AttributePlanes planes = getAttributePlanes(coord_init, delta_col, delta_row);
+    const float inv_w1 = 1 / V(1)[2], inv_w2 = 1 / V(2)[2];
+    const Texture* texture = material->texture.get();
 
-// #pragma omp parallel for schedule(guided)
-    for (int y = y_start; y <= y_end; y++) {
-        int x_start = x_starts[y - y_start];
-        int x_end = x_ends[y - y_start];
+    int x_starts[r.y1 - r.y0 + 1];
+    int x_ends[r.y1 - r.y0 + 1];
+    getXBounds(v, r.y0, r.y1, x_starts, x_ends);
 
-        Vector<float, 3> coord = coord_init + delta_col * (x_start - v[0][0] - 1) + delta_row * (y - v[0][1]);
-        for (int x = x_start; x <= x_end; x++) {
-            coord = coord + delta_col;
-            if (x < 0 || x >= width || y < 0 || y >= height) continue;
-            if (coord[0] < -1 || coord[1] < -1 || coord[2] < -1) continue;
+    for (int y = r.y0; y <= r.y1; y++) {
+        int x_start = std::max(x_starts[y - r.y0], r.x0);
+        int x_end = std::min(x_ends[y - r.y0], r.x1);
 
-            float z = 1 / coord.dot(zinv);
-            int bufferIndex = x + y * width;
-            if (z > window.getDepthBuffer()->at(bufferIndex) + 1e-6) continue;
-            window.getDepthBuffer()->at(bufferIndex) = z;
+        float attributes[ATTRIBUTE_COUNT];
+        std::copy(planes.value, planes.value + ATTRIBUTE_COUNT, attributes);
+        step(attributes, planes.dy, y - v[0][1]);
+        step(attributes, planes.dx, x_start - v[0][0]);
 
-            Vector<float, 2> uv = puv * coord * z;
-            Vector<float, 3> normal = (pn * coord * z).normalize();
+        Vector<float, 3> coord = coord_init + delta_row * (y - v[0][1]) + delta_col * (x_start - v[0][0]);
+        float b0 = coord[0], b1 = coord[1], b2 = coord[2];
+
+        for (int x = x_start; x <= x_end; x++, step(attributes, planes.dx), b0 += db0, b1 += db1, b2 += db2) {
+            if (b0 < -1 || b1 < -1 || b2 < -1) continue;
+
+            float z = 1 / attributes[0];
+            int bufferIndex = x + y * width;
+            if (z > depth_buffer[bufferIndex] + 1e-6) continue;
+            depth_buffer[bufferIndex] = z;
+
+            // The derivatives of u = (u/w) / (1/w) follow from the quotient rule
+            Vector<float, 2> uv = {attributes[1] * z, attributes[2] * z};
+            float level = 0;
+            if (texture) {
+                level = texture->getLevel((planes.dx[1] - uv[0] * planes.dx[0]) * z, (planes.dx[2] - uv[1] * planes.dx[0]) * z,
+                                          (planes.dy[1] - uv[0] * planes.dy[0]) * z, (planes.dy[2] - uv[1] * planes.dy[0]) * z);
+            }
+
+            if (visibility) {
+                visibility[bufferIndex] = Fragment{id, b1 * inv_w1 * z, b2 * inv_w2 * z, level};
+                continue;
+            }
+
+            Vector<float, 3> normal = Vector<float, 3>{attributes[3], attributes[4], attributes[5]}.normalize();
+            color_buffer[bufferIndex] = fragmentShader(x, y, z, uv, normal, level);
+        }
+    }
+}
 
-            // uint32_t color = fragmentShader(x, y, z, uv, normal);
-            // if (color) thread_pixels[omp_get_thread_num()].push_back({x, y, color});
-            drawPixel(x, y, fragmentShader(x, y, z, uv, normal));
+/**
+ * Rasterizes the part of the triangle inside the given tile by evaluating its edge
+ * functions, four pixels at a time.
+ *
+ * The bounding box is walked in BLOCK_SIZE x BLOCK_SIZE blocks. Each block is first
+ * tested at its corner pixels: since the edge functions are linear (and evaluated
+ * monotonically), a block with every corner outside one edge is skipped outright,
+ * and a block with every corner inside all edges skips the per-pixel coverage test.
+ * Pixels are sampled at their centers and ties are broken with the top-left rule,
+ * so meshes are drawn without cracks or double-shaded edges. Attributes come from
+ * their plane equations, stepped down the rows of each block.
+ *
+ * @param tile The region of the screen to rasterize.
+ * @param visibility The visibility buffer to write visible pixels to, to be shaded
+ * later by shade(). Pixels are shaded right away if it is null.
+ * @param id The number the triangle is known by in the visibility buffer.
+ */
+void Triangle::fillHalfSpace(const Rect& tile, Fragment* visibility, uint32_t id) {
+    float twice_area = edge_cross(V(0), V(1), V(2));
+    if (!(std::fabs(twice_area) > 0)) return;
+    const float inv_area = 1.0f / std::fabs(twice_area);
+
+    Rect bounds = getBounds();
+    Rect r = {std::max(bounds.x0, tile.x0), std::max(bounds.y0, tile.y0),
+              std::min(bounds.x1, tile.x1), std::min(bounds.y1, tile.y1)};
+    if (r.empty()) return;
+
+    Window& window = Window::getInstance();
+    const int width = window.getWidth();
+    float* depth_buffer = window.getDepthBuffer()->data();
+    uint32_t* color_buffer = window.getColorBuffer()->data();
+
+    // Edge i is opposite vertex i, so its normalized value is the barycentric weight of vertex i
+    auto makeEdge = [this](const Vector<float, 3>& v0, const Vector<float, 3>& v1) {
+        return Edge{v1[1] - v0[1], v0[0] - v1[0], v0[1] * v1[0] - v0[0] * v1[1], is_top_left(Vector<float, 2>(v1), Vector<float, 2>(v0))};
+    };
+    // Back faces are only drawn if they were not culled. Their edges are reversed so that
+    // the inside is still positive, which negates them exactly and keeps shared edges watertight.
+    const bool back = twice_area > 0;
+    auto edge = [&](uint32_t i, uint32_t j) { return back ? makeEdge(V(j), V(i)) : makeEdge(V(i), V(j)); };
+    const Edge edges[3] = {edge(1, 2), edge(2, 0), edge(0, 1)};
+
+    // Perspective-correct interpolation setup, with the attribute planes anchored at the first block's first pixel
+    const float anchor_x = float(r.x0 & ~(BLOCK_SIZE - 1)) + 0.5f;
+    const float anchor_y = float(r.y0 & ~(BLOCK_SIZE - 1)) + 0.5f;
+    const AttributePlanes planes = getAttributePlanes(
+        Vector<float, 3>{edges[0].eval(anchor_x, anchor_y), edges[1].eval(anchor_x, anchor_y), edges[2].eval(anchor_x, anchor_y)} * inv_area,
+        Vector<float, 3>{edges[0].a, edges[1].a, edges[2].a} * inv_area,
+        Vector<float, 3>{edges[0].b, edges[1].b, edges[2].b} * inv_area);
+    const float weight_scale1 = inv_area / V(1)[2], weight_scale2 = inv_area / V(2)[2];
+    const Texture* texture = material->texture.get();
+
+    // Filling the visibility buffer only needs 1/w, and u/w and v/w for the level of detail
+    const size_t attributeCount = visibility ? (texture ? 3 : 1) : ATTRIBUTE_COUNT;
+
+    const int4 full = {-1, -1, -1, -1};
+    const float4 corner_x = {0.5f, BLOCK_SIZE - 0.5f, 0.5f, BLOCK_SIZE - 0.5f};
+    const float4 corner_y = {0.5f, 0.5f, BLOCK_SIZE - 0.5f, BLOCK_SIZE - 0.5f};
+
+    for (int by = r.y0 & ~(BLOCK_SIZE - 1); by <= r.y1; by += BLOCK_SIZE) {
+        for (int bx = r.x0 & ~(BLOCK_SIZE - 1); bx <= r.x1; bx += BLOCK_SIZE) {
+            bool rejected = false, accepted = true;
+            for (const Edge& edge : edges) {
+                int4 inside = edge.covers(edge.eval(float(bx) + corner_x, float(by) + corner_y));
+                rejected |= !any(inside);
+                accepted &= all(inside);
+            }
+            if (rejected) continue;
+
+            // The attributes at the first quad of each row of quads, stepped down two rows at a time.
+            // Quads are offset from their row only once they are known to be covered, so empty
+            // quads cost nothing.
+            float4 row[ATTRIBUTE_COUNT];
+            for (size_t k = 0; k < ATTRIBUTE_COUNT; k++) {
+                row[k] = planes.value[k] + planes.dx[k] * (float(bx) + QUAD_X - anchor_x) +
+                         planes.dy[k] * (float(by) + QUAD_Y - anchor_y);
+            }
+
+            for (int qy = by; qy < by + BLOCK_SIZE; qy += 2, step(row, planes.dy, 2.0f)) {
+                for (int qx = bx; qx < bx + BLOCK_SIZE; qx += 2) {
+                    float4 x = float(qx) + QUAD_X, y = float(qy) + QUAD_Y;
+                    float4 f0 = edges[0].eval(x, y), f1 = edges[1].eval(x, y), f2 = edges[2].eval(x, y);
+
+                    int4 px = qx + QUAD_DX, py = qy + QUAD_DY;
+                    int4 mask = accepted ? full : edges[0].covers(f0) & edges[1].covers(f1) & edges[2].covers(f2);
+                    mask &= (px >= r.x0) & (px <= r.x1) & (py >= r.y0) & (py <= r.y1);
+                    if (!any(mask)) continue;
+
+                    float4 quad[ATTRIBUTE_COUNT];
+                    for (size_t k = 0; k < attributeCount; k++) quad[k] = row[k] + planes.dx[k] * float(qx - bx);
+                    float4 z = 1.0f / quad[0];
+
+                    // The level of detail comes from the differences across the quad, so all
+                    // four lanes are interpolated even where the triangle does not cover them.
+                    // Untextured visibility fills only interpolate 1/w and need neither.
+                    float4 u = {}, v = {};
+                    if (attributeCount >= 3) {
+                        u = quad[1] * z;
+                        v = quad[2] * z;
+                    }
+                    float level = 0;
+                    if (texture) level = texture->getLevel(u[1] - u[0], v[1] - v[0], u[2] - u[0], v[2] - v[0]);
+
+                    for (int lane = 0; lane < 4; lane++) {
+                        if (!mask[lane]) continue;
+                        int bufferIndex = px[lane] + py[lane] * width;
+                        if (z[lane] > depth_buffer[bufferIndex] + 1e-6) continue;
+                        depth_buffer[bufferIndex] = z[lane];
+
+                        if (visibility) {
+                            visibility[bufferIndex] =
+                                Fragment{id, f1[lane] * weight_scale1 * z[lane], f2[lane] * weight_scale2 * z[lane], level};
+                            continue;
+                        }
+
+                        Vector<float, 2> uv = {u[lane], v[lane]};
+                        Vector<float, 3> normal = Vector<float, 3>{quad[3][lane], quad[4][lane], quad[5][lane]}.normalize();
+
+                        color_buffer[bufferIndex] = fragmentShader(px[lane], py[lane], z[lane], uv, normal, level);
+                    }
+                }
+            }
         }
     }
+}
 
-    // for (const auto& thread_pixel : thread_pixels) {
-    //     for (const auto& pixel : thread_pixel) {
-    //         drawPixel(pixel.x, pixel.y, pixel.color);
-    //     }
-    // }
+/**
+ * @brief Shades a pixel the triangle covers in the visibility buffer.
+ *
+ * The perspective-correct weights stored for the pixel interpolate the vertex
+ * attributes directly, so no division by w is left to do. The texture's level of
+ * detail was already picked while rasterizing.
+ *
+ * @param x, y The pixel to shade.
+ * @param z The pixel's depth.
+ * @param fragment The pixel's entry in the visibility buffer.
+ * @return The pixel's color.
+ */
+uint32_t Triangle::shade(int x, int y, float z, const Fragment& fragment) {
+    const float b0 = 1 - fragment.b1 - fragment.b2;
+    Vector<float, 2> uv = T(0) * b0 + T(1) * fragment.b1 + T(2) * fragment.b2;
+    Vector<float, 3> normal = (N(0) * b0 + N(1) * fragment.b1 + N(2) * fragment.b2).normalize();
+    return fragmentShader(x, y, z, uv, normal, fragment.level);
 }
 
 void Triangle::print() {
-    std::cout << "Vertices: " << vidx[0] << ", " << vidx[1] << ", " << vidx[2] << "\n";
+    std::cout << "Vertices: " << vertexIndex(0) << ", " << vertexIndex(1) << ", " << vertexIndex(2) << "\n";
     V(0).print();
     V(1).print();
     V(2).print();
-    std::cout << "\nTextures: " << uvidx[0] << ", " << uvidx[1] << ", " << uvidx[2] << "\n";
+    std::cout << "\nTextures:\n";
     T(0).print();
     T(1).print();
     T(2).print();
-    std::cout << "\nNormals: " << nidx[0] << ", " << nidx[1] << ", " << nidx[2] << "\n";
+    std::cout << "\nNormals:\n";
     N(0).print();
     N(1).print();
     N(2).print();
-    std::cout << "\nMaterial: " << material.name << "\n";
+    std::cout << "\nMaterial: " << material->name << "\n";
 }
\ No newline at end of file
@@ -2,7 +2,7 @@
 
 #include <SDL2/SDL.h>
 
-#include <memory>
+#include <cstddef>
 
 #include "linalg.hpp"
 #include "material.hpp"
@@ -15,9 +15,54 @@
 
 struct Object;
 
+// The attributes interpolated across a triangle, each divided by w: 1/w, u/w, v/w and the normal over w
+#define ATTRIBUTE_COUNT 6
+
+/**
+ * The attributes of a triangle as planes in screen space. value holds each attribute
+ * at an anchor point, dx and dy how much it changes per pixel to the right and per
+ * row down. Attributes divided by w are linear in screen space, so stepping them by
+ * their gradients is exact up to rounding.
+ */
+struct AttributePlanes {
+    float value[ATTRIBUTE_COUNT];
+    float dx[ATTRIBUTE_COUNT];
+    float dy[ATTRIBUTE_COUNT];
+};
+
+// Marks a pixel of the visibility buffer that no triangle covers
+#define NO_TRIANGLE UINT32_MAX
+
+/**
+ * One pixel of the visibility buffer: the binned triangle nearest to the camera at
+ * that pixel, the perspective-correct weights of its second and third vertices, the
+ * first one's being whatever is left, and the texture's level of detail there.
+ * Shading it later gives the same result as shading the pixel while the triangle
+ * was rasterized.
+ */
+struct Fragment {
+    uint32_t triangle = NO_TRIANGLE;
+    float b1, b2;
+    float level;
+};
+
+/**
+ * A view of one triangle of an Object, used while a frame is drawn.
+ *
+ * The triangle's corners live in the Object's flat index buffer, so a Triangle
+ * only names the Object, the triangle's position in that buffer and the
+ * material to shade it with. It is cheap to create and copy, and holds no state
+ * of its own between frames. When several instances of the Object are drawn,
+ * each one's transformed vertices and normals are stored after the previous
+ * one's, and base is added to a vertex index to find it in the part of the
+ * triangle's instance.
+ */
 class Triangle {
    private:
-    Window& window;
+    const Object* object;
+    const Material* material;
+    ptrdiff_t base;
+    uint32_t index;
 
     float edge_cross(const Vector<float, 3>& v0, const Vector<float, 3>& v1, const Vector<float, 3>& v2) {
         Vector<float, 2> edge1 = v1 - v0;
@@ -29,39 +74,35 @@ class Triangle {
         return (v1[1] > v2[1]) || (v1[1] == v2[1] && v1[0] < v2[0]);
     };
 
-    float lerp(float a, float b, float t) { return a + (b - a) * t; };
-    uint32_t sample(Vector<float, 2>& uv);
+    uint32_t sample(Vector<float, 2>& uv, float level);
 
     void drawPixel(int x, int y, uint32_t color);
     void drawLine(const Vector<float, 3>& v1, const Vector<float, 3>& v2);
 
     bool inBounds(int x, int y, int w, int h) { return x >= 0 && x < w && y >= 0 && y < h; };
-    bool AllOutOfBounds();
 
-    const Vector<float, 3>& V(uint32_t idx) const;
+    Vector<float, 3> V(uint32_t idx) const;
     const Vector<float, 2>& T(uint32_t idx) const;
-    const Vector<float, 3>& N(uint32_t idx) const;
+    Vector<float, 3> N(uint32_t idx) const;
+    AttributePlanes getAttributePlanes(const Vector<float, 3>& weights, const Vector<float, 3>& weights_dx,
+                                       const Vector<float, 3>& weights_dy) const;
 
    public:
-    const uint32_t vidx[3];
-    const uint32_t uvidx[3];
-    const uint32_t nidx[3];
-
-    const Material& material;
-    const Object& object;
-
-    Triangle(const uint32_t vidx[], const uint32_t uvidx[], uint32_t nidx[],
-             const Material& material, const Object& object) : window(Window::getInstance()),
-                                                               vidx{vidx[0], vidx[1], vidx[2]},
-                                                               uvidx{uvidx[0], uvidx[1], uvidx[2]},
-                                                               nidx{nidx[0], nidx[1], nidx[2]},
-                                                               material(material),
-                                                               object(object) {};
-                                                               
+    Triangle(const Object& object, uint32_t index, const Material& material, ptrdiff_t base = 0) : object(&object),
+                                                                                                   material(&material),
+                                                                                                   base(base),
+                                                                                                   index(index) {};
+
+    uint32_t vertexIndex(uint32_t i) const;
+    const Material& getMaterial() const { return *material; }
+
     void draw();
-    uint32_t fragmentShader(int x, int y, float z, Vector<float, 2>& uv, Vector<float, 3>& n);
-    void getXBounds(Vector<float, 3> v[3], int x_starts[], int x_ends[]);
-    void fill();
+    uint32_t fragmentShader(int x, int y, float z, Vector<float, 2>& uv, Vector<float, 3>& n, float level);
+    void getXBounds(Vector<float, 3> v[3], int y0, int y1, int x_starts[], int x_ends[]);
+    Rect getBounds() const;
+    void fill(const Rect& tile, Fragment* visibility = nullptr, uint32_t id = 0);
+    void fillHalfSpace(const Rect& tile, Fragment* visibility = nullptr, uint32_t id = 0);
+    uint32_t shade(int x, int y, float z, const Fragment& fragment);
 
     void print();
 };
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "aligned.hpp"
+#include "linalg.hpp"
+
+#define SIMD_WIDTH 8
+#define SIMD_ALIGN 32
+
+/**
+ * Stores a list of N-component vertices as a structure of arrays.
+ *
+ * Each component lives in its own aligned float array whose length is padded
+ * to a multiple of SIMD_WIDTH with zeros. Loops over data(c) can therefore run
+ * over paddedSize() elements in whole SIMD_WIDTH blocks without a remainder loop.
+ */
+template <size_t N>
+class VertexArray {
+   private:
+    size_t count = 0;
+    std::array<std::vector<float, AlignedAllocator<float, SIMD_ALIGN>>, N> components;
+
+   public:
+    // Rounds n up to a whole number of SIMD_WIDTH blocks
+    static size_t padded(size_t n) { return (n + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH; }
+
+    size_t size() const { return count; }
+    size_t paddedSize() const { return padded(count); }
+    bool empty() const { return count == 0; }
+
+    float* data(size_t component) { return components[component].data(); }
+    const float* data(size_t component) const { return components[component].data(); }
+
+    // The padding is zeroed again on every resize, since shrinking leaves old vertices behind it
+    void resize(size_t n) {
+        count = n;
+        for (auto& component : components) {
+            component.resize(padded(n));
+            std::fill(component.begin() + n, component.end(), 0.0f);
+        }
+    }
+
+    void push_back(const Vector<float, N>& vertex) {
+        resize(count + 1);
+        set(count - 1, vertex);
+    }
+
+    void set(size_t index, const Vector<float, N>& vertex) {
+        for (size_t c = 0; c < N; c++) components[c][index] = vertex[c];
+    }
+
+    Vector<float, N> operator[](size_t index) const {
+        Vector<float, N> vertex;
+        for (size_t c = 0; c < N; c++) vertex[c] = components[c][index];
+        return vertex;
+    }
+};
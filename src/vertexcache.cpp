@@ -0,0 +1,198 @@
+#include "vertexcache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "object.hpp"
+
+/**
+ * Scores a vertex by how much emitting one of its triangles next would help the
+ * cache: vertices near the front of the cache score higher, and vertices with few
+ * triangles left score higher so that they are finished off instead of being
+ * left behind as isolated triangles.
+ *
+ * @param cachePosition The vertex's position in the simulated cache, or -1 if it is not in it.
+ * @param remaining The number of the vertex's triangles not emitted yet.
+ */
+static float vertexScore(int cachePosition, uint32_t remaining) {
+    if (remaining == 0) return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0 && cachePosition < 3) {
+        // Used by the last triangle. Slightly penalized so strips do not keep turning back on themselves.
+        score = 0.75f;
+    } else if (cachePosition >= 3) {
+        score = powf(1.0f - float(cachePosition - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+    return score + 2.0f / sqrtf(float(remaining));
+}
+
+/**
+ * @brief Reorders triangles so that consecutive triangles share vertices.
+ *
+ * Implements Tom Forsyth's linear-speed vertex cache optimization. A cache of
+ * the VERTEX_CACHE_SIZE most recently used vertices is simulated, and the next
+ * triangle is always the one whose vertices score highest, which is searched
+ * among the triangles of the cached vertices only. The result walks the mesh in
+ * compact strips, so each vertex is used by several triangles in a row.
+ *
+ * @param indices The index buffer to reorder in place, with three entries per triangle.
+ * @param triangleCount The number of triangles in the buffer.
+ */
+void optimizeVertexCache(uint32_t* indices, uint32_t triangleCount) {
+    if (triangleCount < 2) return;
+    const size_t indexCount = 3 * size_t(triangleCount);
+
+    // Number the vertices used by these triangles from 0
+    std::vector<uint32_t> vertices(indices, indices + indexCount);
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+    const size_t vertexCount = vertices.size();
+
+    std::vector<uint32_t> corners(indexCount);
+    for (size_t i = 0; i < indexCount; i++) {
+        corners[i] = std::lower_bound(vertices.begin(), vertices.end(), indices[i]) - vertices.begin();
+    }
+
+    // The triangles of each vertex, the not yet emitted ones first
+    std::vector<uint32_t> remaining(vertexCount, 0), offsets(vertexCount + 1, 0), adjacency(indexCount);
+    for (uint32_t vertex : corners) remaining[vertex]++;
+    for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indexCount; i++) adjacency[filled[corners[i]]++] = i / 3;
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) score[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = score[corners[3 * t]] + score[corners[3 * t + 1]] + score[corners[3 * t + 2]];
+    }
+
+    std::vector<uint32_t> order, cache, nextCache;
+    order.reserve(triangleCount);
+    cache.reserve(VERTEX_CACHE_SIZE + 3);
+    nextCache.reserve(VERTEX_CACHE_SIZE + 3);
+
+    int64_t best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+    while (order.size() < triangleCount) {
+        // No cached vertex has triangles left, so start again at the best triangle anywhere
+        if (best < 0) {
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                if (!emitted[t] && (best < 0 || triangleScore[t] > triangleScore[best])) best = t;
+            }
+        }
+
+        order.push_back(best);
+        emitted[best] = true;
+
+        nextCache.clear();
+        for (size_t i = 0; i < 3; i++) {
+            const uint32_t vertex = corners[3 * best + i];
+            nextCache.push_back(vertex);
+
+            // Move the triangle behind the vertex's remaining triangles
+            uint32_t* first = &adjacency[offsets[vertex]];
+            uint32_t* last = first + remaining[vertex] - 1;
+            std::iter_swap(std::find(first, last + 1, uint32_t(best)), last);
+            remaining[vertex]--;
+        }
+        for (uint32_t vertex : cache) {
+            if (std::find(nextCache.begin(), nextCache.begin() + 3, vertex) == nextCache.begin() + 3) nextCache.push_back(vertex);
+        }
+
+        // Rescore every vertex whose cache position changed, including the ones that fell out
+        for (size_t i = 0; i < nextCache.size(); i++) cachePosition[nextCache[i]] = i < VERTEX_CACHE_SIZE ? int(i) : -1;
+        for (uint32_t vertex : nextCache) score[vertex] = vertexScore(cachePosition[vertex], remaining[vertex]);
+
+        best = -1;
+        for (uint32_t vertex : nextCache) {
+            for (uint32_t i = offsets[vertex]; i < offsets[vertex] + remaining[vertex]; i++) {
+                const uint32_t t = adjacency[i];
+                triangleScore[t] = score[corners[3 * t]] + score[corners[3 * t + 1]] + score[corners[3 * t + 2]];
+                if (best < 0 || triangleScore[t] > triangleScore[best]) best = t;
+            }
+        }
+
+        if (nextCache.size() > VERTEX_CACHE_SIZE) nextCache.resize(VERTEX_CACHE_SIZE);
+        std::swap(cache, nextCache);
+    }
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (size_t i = 0; i < 3; i++) indices[3 * t + i] = vertices[corners[3 * order[t] + i]];
+    }
+}
+
+/**
+ * @brief Measures how often a FIFO cache of VERTEX_CACHE_SIZE vertices misses
+ * while the triangles are drawn in order.
+ *
+ * This is the cache size optimizeVertexCache() orders triangles for, so the
+ * result measures the optimization against its own target.
+ *
+ * @param indices The index buffer, with three entries per triangle.
+ * @param triangleCount The number of triangles in the buffer.
+ * @return The average cache miss ratio: the number of vertices loaded per triangle.
+ */
+float averageCacheMissRatio(const uint32_t* indices, uint32_t triangleCount) {
+    if (triangleCount == 0) return 0;
+
+    std::vector<uint32_t> cache(VERTEX_CACHE_SIZE, UINT32_MAX);
+    size_t next = 0, misses = 0;
+    for (size_t i = 0; i < 3 * size_t(triangleCount); i++) {
+        if (std::find(cache.begin(), cache.end(), indices[i]) != cache.end()) continue;
+        cache[next] = indices[i];
+        next = (next + 1) % VERTEX_CACHE_SIZE;
+        misses++;
+    }
+    return float(misses) / triangleCount;
+}
+
+/**
+ * @brief Renumbers the vertices of an Object in the order its triangles first use them.
+ *
+ * Triangles that are drawn together then read neighbouring vertices, and every
+ * contiguous run of triangles references a compact range of vertex indices. The
+ * placeholder at index 0 keeps its place and vertices no triangle uses move to the
+ * end. The model-space arrays are permuted and copied into the per-frame arrays.
+ *
+ * @param object The Object to renumber.
+ */
+void optimizeVertexFetch(Object& object) {
+    const size_t vertexCount = object.modelVertices.size();
+    if (vertexCount == 0) return;
+
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX), order;
+    order.reserve(vertexCount);
+    remap[0] = 0;
+    order.push_back(0);
+    for (uint32_t& index : object.indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = order.size();
+            order.push_back(index);
+        }
+        index = remap[index];
+    }
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        if (remap[v] == UINT32_MAX) order.push_back(v);
+    }
+
+    VertexArray<3> vertices, normals;
+    std::vector<Vector<float, 2>> textures(vertexCount);
+    vertices.resize(vertexCount);
+    normals.resize(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        vertices.set(v, object.modelVertices[order[v]]);
+        normals.set(v, object.modelNormals[order[v]]);
+        textures[v] = object.textures[order[v]];
+    }
+
+    object.modelVertices = vertices;
+    object.modelNormals = normals;
+    object.vertices = std::move(vertices);
+    object.normals = std::move(normals);
+    object.textures = std::move(textures);
+}
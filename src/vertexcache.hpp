@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+struct Object;
+
+// The number of most recently used vertices the triangle order is optimized for
+#define VERTEX_CACHE_SIZE 32
+
+void optimizeVertexCache(uint32_t* indices, uint32_t triangleCount);
+float averageCacheMissRatio(const uint32_t* indices, uint32_t triangleCount);
+void optimizeVertexFetch(Object& object);
@@ -1,51 +1,106 @@
 #include "window.hpp"
 
+#include <SDL2/SDL_image.h>
+
+#include <fstream>
+
+#include "profiler.hpp"
+
 #define FLOAT_MAX std::numeric_limits<float>::max()
 #define R(c) ((c >> 24) & 0xFF)
 #define G(c) ((c >> 16) & 0xFF)
 #define B(c) ((c >> 8) & 0xFF)
 #define A(c) (c & 0xFF)
 
-Window::Window(int width, int height, uint32_t bgColor): bgColor(bgColor) {
-    SDL_Init(SDL_INIT_VIDEO);
-    SDL_CreateWindowAndRenderer(width, height, 0, &window, &renderer);
-    // SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN);
+Window::Window(int width, int height, uint32_t bgColor, bool headless): width(width), height(height), bgColor(bgColor), headless(headless) {
+    viewport = Viewport{float(width), float(height), float(std::max(width, height))};
+
+    // A headless window only owns the color and depth buffers, so it can render without a display
+    if (!headless) {
+        SDL_Init(SDL_INIT_VIDEO);
+        SDL_CreateWindowAndRenderer(width, height, 0, &window, &renderer);
+        // SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN);
+
+        SDL_SetRenderDrawColor(renderer, R(bgColor), G(bgColor), B(bgColor), A(bgColor));
+        SDL_RenderClear(renderer);
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+
+        // The rasterizer writes packed RGBA pixels into color_buffer, which is uploaded once per frame
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    }
 
-    SDL_SetRenderDrawColor(renderer, R(bgColor), G(bgColor), B(bgColor), A(bgColor));
-    SDL_RenderClear(renderer);
-    SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
     depth_buffer = std::make_shared<std::vector<float>>(width * height, FLOAT_MAX);
+    color_buffer = std::make_shared<std::vector<uint32_t>>(width * height, bgColor | 0xFF);
 }
 
 Vector<float, 4> Window::toDeviceCoordinates(Vector<float, 4> vertex) {
-    int width, height;
-    SDL_GetWindowSize(window, &width, &height);
-
     float depth = vertex[3];
     vertex = vertex / depth;
-    
-    vertex[0] = (width + vertex[0] * std::max(width, height)) / 2.0f;
-    vertex[1] = (height - vertex[1] * std::max(width, height)) / 2.0f;
+
+    vertex[0] = (viewport.width + vertex[0] * viewport.scale) / 2.0f;
+    vertex[1] = (viewport.height - vertex[1] * viewport.scale) / 2.0f;
     vertex[2] = depth;
 
     return vertex;
 }
 
 
-Window& Window::getInstance(int width, int height, uint32_t bgColor) {
-    static Window instance(width, height, bgColor);
+Window& Window::getInstance(int width, int height, uint32_t bgColor, bool headless) {
+    static Window instance(width, height, bgColor, headless);
     return instance;
 }
 
 void Window::clear() {
-    int width, height;
-    SDL_GetWindowSize(window, &width, &height);
-    SDL_SetRenderDrawColor(renderer, R(bgColor), G(bgColor), B(bgColor), 255);
-    SDL_RenderClear(renderer);
     depth_buffer->assign(width * height, FLOAT_MAX);
+    color_buffer->assign(width * height, bgColor | 0xFF);
+}
+
+/**
+ * Uploads the color buffer to the streaming texture and presents it.
+ * This is the only point per frame where pixel data crosses into SDL.
+ */
+void Window::render() {
+    if (headless) return;
+    uint64_t startTime = Profiler::getInstance().now();
+    SDL_UpdateTexture(texture, nullptr, color_buffer->data(), width * sizeof(uint32_t));
+    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    SDL_RenderPresent(renderer);
+    Profiler::getInstance().record(PRESENT, startTime);
+}
+
+/**
+ * Writes the color buffer to disk. The image is saved as a PNG if the path ends
+ * in .png and as a binary PPM otherwise.
+ *
+ * @param path The file to write.
+ * @return True if the image was written successfully.
+ */
+bool Window::saveImage(const std::string& path) {
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0) {
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(color_buffer->data(), width, height, 32,
+                                                                  width * sizeof(uint32_t), SDL_PIXELFORMAT_RGBA8888);
+        if (!surface) return false;
+        int result = IMG_SavePNG(surface, path.c_str());
+        SDL_FreeSurface(surface);
+        return result == 0;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (uint32_t color : *color_buffer) {
+        char rgb[] = {char(R(color)), char(G(color)), char(B(color))};
+        file.write(rgb, 3);
+    }
+    return file.good();
 }
 
 int Window::quit() {
+    if (texture) {
+        SDL_DestroyTexture(texture);
+        texture = nullptr;
+    }
     if (renderer) {
         SDL_DestroyRenderer(renderer);
         renderer = nullptr;
@@ -5,29 +5,49 @@
 #include <SDL2/SDL.h>
 #include <vector>
 #include <memory>
+#include <string>
+
+/**
+ * An inclusive rectangle of pixels in screen space.
+ */
+struct Rect {
+    int x0, y0, x1, y1;
+    bool empty() const { return x0 > x1 || y0 > y1; }
+};
 
 class Window {
 private:
+    int width, height;
+    Viewport viewport;
     uint32_t bgColor;
+    bool headless;
     SDL_Window* window = nullptr;
     SDL_Renderer* renderer = nullptr;
+    SDL_Texture* texture = nullptr;
     std::shared_ptr<std::vector<float>> depth_buffer;
+    std::shared_ptr<std::vector<uint32_t>> color_buffer;
 
-    Window(int width, int height, uint32_t bgColor);
+    Window(int width, int height, uint32_t bgColor, bool headless);
 
 public:
     Window(const Window&) = delete;
     Window& operator=(const Window&) = delete;
-    static Window& getInstance(int width = 800, int height = 600, uint32_t bgColor = 0x000000FF);
+    static Window& getInstance(int width = 800, int height = 600, uint32_t bgColor = 0x000000FF, bool headless = false);
 
     SDL_Window* getWindow() { return window; }
     SDL_Renderer* getRenderer() { return renderer; }
+    int getWidth() { return width; }
+    int getHeight() { return height; }
+    Viewport getViewport() { return viewport; }
+    bool isHeadless() { return headless; }
     std::shared_ptr<std::vector<float>> getDepthBuffer() { return depth_buffer; }
+    std::shared_ptr<std::vector<uint32_t>> getColorBuffer() { return color_buffer; }
 
     Vector<float, 4> toDeviceCoordinates(Vector<float, 4> vertex);
 
-    void render() { SDL_RenderPresent(renderer); }
+    void render();
     void clear();
+    bool saveImage(const std::string& path);
     int quit();
     ~Window() { quit(); };
 };
\ No newline at end of file
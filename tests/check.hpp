@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <string>
+
+inline int failures = 0;
+
+/**
+ * Prints whether a check passed and counts it if it did not.
+ */
+inline void check(bool condition, const std::string& name) {
+    std::cout << (condition ? "PASS " : "FAIL ") << name << std::endl;
+    if (!condition) failures++;
+}
+
+/**
+ * Prints a summary of the checks run so far and returns the program's exit status.
+ */
+inline int report() {
+    std::cout << (failures ? "Some checks failed" : "All checks passed") << std::endl;
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
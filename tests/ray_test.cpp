@@ -0,0 +1,62 @@
+#include "camera.hpp"
+#include "check.hpp"
+#include "mesh.hpp"
+#include "object.hpp"
+#include "window.hpp"
+
+/**
+ * Builds an Object holding the square [-1, 1] x [-1, 1] at z = -5, split into two
+ * triangles, after the placeholder vertex at index 0.
+ */
+static Object makeSquare(const Material& material) {
+    Object square;
+    const Vector<float, 3> corners[] = {{0, 0, 0}, {-1, -1, -5}, {1, -1, -5}, {1, 1, -5}, {-1, 1, -5}};
+    for (const Vector<float, 3>& corner : corners) square.modelVertices.push_back(corner);
+    const uint32_t first[] = {1, 2, 3}, second[] = {1, 3, 4};
+    square.addTriangle(first, material);
+    square.addTriangle(second, material);
+    square.bvh.build(square);
+    return square;
+}
+
+static void testBVH() {
+    Material material;
+    Object square = makeSquare(material);
+
+    RayHit hit;
+    check(square.bvh.intersect(Ray{{0.5f, 0.5f, 0}, {0, 0, -1}}, square, hit) && hit.t == 5,
+          "a ray through the square hits it at its distance");
+
+    RayHit miss;
+    check(!square.bvh.intersect(Ray{{3, 0, 0}, {0, 0, -1}}, square, miss), "a ray beside the square misses it");
+
+    RayHit away;
+    check(!square.bvh.intersect(Ray{{0, 0, 0}, {0, 0, 1}}, square, away), "a ray pointing away from the square misses it");
+
+    // The origin lies on the box's x = -1 plane and the direction has a zero x, where the slab distance is 0 * -inf
+    RayHit onPlane;
+    check(square.bvh.intersect(Ray{{-1, 0.5f, 0}, {-0.0f, 0, -1}}, square, onPlane) && onPlane.t == 5,
+          "a ray parallel to a box face and starting on it still hits");
+}
+
+static void testPicking() {
+    Window& window = Window::getInstance();
+    Camera camera(60, 0.1f, 100.0f);
+    Mesh mesh("src/Assets/Grass_Block");
+    mesh.setPosition({0, 0, -10});
+
+    RayHit hit;
+    const Ray center = camera.getRay(window.getWidth() / 2.0f, window.getHeight() / 2.0f, window.getViewport());
+    check(mesh.intersect(center, hit) && hit.t > 8 && hit.t < 10, "the ray through the center pixel picks the block");
+
+    RayHit miss;
+    check(!mesh.intersect(camera.getRay(0, 0, window.getViewport()), miss), "the ray through a corner pixel misses the block");
+}
+
+int main() {
+    Window::getInstance(800, 600, 0x000000FF, true);
+    testBVH();
+    testPicking();
+
+    return report();
+}
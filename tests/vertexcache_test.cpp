@@ -0,0 +1,36 @@
+#include <unordered_map>
+
+#include "check.hpp"
+#include "material.hpp"
+#include "object.hpp"
+#include "parser.hpp"
+#include "vertexcache.hpp"
+
+/**
+ * Returns the average cache miss ratio of all objects of a model together.
+ */
+static float modelCacheMissRatio(const std::unordered_map<std::string, Object>& objects) {
+    float misses = 0;
+    uint32_t triangles = 0;
+    for (const auto& [name, obj] : objects) {
+        misses += averageCacheMissRatio(obj.indices.data(), obj.triangleCount()) * obj.triangleCount();
+        triangles += obj.triangleCount();
+    }
+    return triangles ? misses / triangles : 0;
+}
+
+int main() {
+    std::unordered_map<std::string, Object> objects;
+    std::unordered_map<std::string, Material> materials;
+    Parser(objects, materials).parse("src/Assets/Utah_Teapot");
+
+    for (auto& [name, obj] : objects) obj.bvh.build(obj);
+    const float before = modelCacheMissRatio(objects);
+    for (auto& [name, obj] : objects) obj.bvh.optimize(obj);
+    const float after = modelCacheMissRatio(objects);
+
+    std::cout << "Teapot ACMR with a " << VERTEX_CACHE_SIZE << "-entry FIFO: " << before << " -> " << after << std::endl;
+    check(after < before, "optimizing for the vertex cache lowers the teapot's cache miss ratio");
+    check(averageCacheMissRatio(nullptr, 0) == 0, "an empty index buffer has no misses");
+    return report();
+}